@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+
+#include <TTree.h>
+#include <CollectorConfig.h>
+
+// decides which events of a file period get their waveforms stored
+class AcquisitionSampler {
+    public:
+
+        // start new period [periodStart, periodEnd) in ns
+        void reset(AcquisitionLimitMode mode_, int limit_, int buckets_, Long64_t periodStart_, Long64_t periodEnd_) {
+            mode = mode_;
+            limit = std::max(limit_, 0);
+            buckets = std::max(buckets_, 1);
+            periodStart = periodStart_;
+            periodLength = std::max<Long64_t>(periodEnd_ - periodStart_, 1);
+            accepted = 0;
+        }
+
+        // check whether the waveforms of the event are kept
+        bool accept(Long64_t eventTime) {
+
+            // quota available up to this event
+            int64_t quota = limit;
+
+            if (mode == AcquisitionLimitMode::TimeUniform) {
+
+                // bucket of the event inside the period
+                Long64_t offset = std::clamp<Long64_t>(eventTime - periodStart, 0, periodLength - 1);
+                int64_t bucket = static_cast<int64_t>(static_cast<double>(offset) / periodLength * buckets);
+
+                // the quota grows with every bucket, unused quota is carried over
+                quota = static_cast<int64_t>(limit) * (bucket + 1) / buckets;
+            }
+
+            if (accepted >= quota) return false;
+
+            accepted++;
+            return true;
+        }
+
+    private:
+        AcquisitionLimitMode mode = AcquisitionLimitMode::FirstEvents;
+        int limit = 0;
+        int buckets = 1;
+
+        Long64_t periodStart = 0;
+        Long64_t periodLength = 1;
+
+        int64_t accepted = 0;
+};
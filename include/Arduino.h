@@ -1,12 +1,13 @@
 #pragma once
 
-#include <thread>
+#include <functional>
 #include <QObject>
+#include <QThread>
 #include <QSerialPort>
 #include <QSerialPortInfo>
 
 #include <ArduinoData.h>
-#include <TSQueue.h>
+#include <SPSCQueue.h>
 
 class TimeTagHandler;
 class CollectorConfig;
@@ -37,11 +38,23 @@ class Arduino : public QObject{
         // get data
         std::optional<ArduinoData> getArduinoData() { return q.pop(); };
 
+        // number of readings waiting in the queue
+        size_t getQueueSize() { return q.size(); };
+
+        // wake consumer on new data
+        void setNotifier(DataNotifier* notifier) { q.setNotifier(notifier); };
+
     private slots:
         // collect Data
         void onReadyRead();
 
     private:
+        // run function in the serial thread and wait for the result
+        bool runInSerialThread(std::function<bool()> fn);
+
+        // own event loop for serial port, parsing and time stamps
+        QThread *serialThread;
+
         // status
         bool isCollecting = false;
         uint64_t lineNumber = 0;
@@ -53,8 +66,8 @@ class Arduino : public QObject{
         // buffer to store stream data
         QByteArray buffer;
 
-        // queue for the data from Arduino
-        TSQueue<ArduinoData> q;
+        // queue for the data from Arduino (old readings are dropped if full)
+        SPSCQueue<ArduinoData> q{1024, QueueFullPolicy::DropOldest};
 
         // Time Tag Handler
         std::shared_ptr<TimeTagHandler> TTH;
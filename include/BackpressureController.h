@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+
+#include <TTree.h>
+
+// data reduction steps if the writer cannot keep up
+enum class DegradationLevel {
+    FullWaveforms = 0,      // complete waveforms
+    TrimmedWaveforms = 1,   // waveforms cut around the trigger
+    FeaturesOnly = 2,       // no waveforms, features of every event
+    CountsOnly = 3          // events are only counted for the rate
+};
+
+// steps the degradation level down and up depending on queue depth, writer lag and memory
+class BackpressureController {
+    public:
+
+        // set limits (lag and hold time in ns)
+        void configure(size_t highWater_, size_t lowWater_, Long64_t maxLag_, Long64_t holdTime_) {
+            highWater = highWater_;
+            lowWater = lowWater_;
+            maxLag = maxLag_;
+            holdTime = holdTime_;
+        }
+
+        // start with full waveforms
+        void reset(Long64_t now) {
+            level = DegradationLevel::FullWaveforms;
+            lastChange = now;
+        }
+
+        // update level, returns true if the level changed
+        bool update(size_t queueDepth, Long64_t lag, bool overBudget, Long64_t now) {
+
+            // keep every level for a minimum time
+            if (now - lastChange < holdTime) return false;
+
+            bool overloaded = queueDepth > highWater || lag > maxLag || overBudget;
+            bool relaxed = queueDepth < lowWater && lag < maxLag / 2 && !overBudget;
+
+            // step down
+            if (overloaded && level != DegradationLevel::CountsOnly) {
+                level = static_cast<DegradationLevel>(static_cast<int>(level) + 1);
+                lastChange = now;
+                return true;
+            }
+
+            // step up
+            if (relaxed && level != DegradationLevel::FullWaveforms) {
+                level = static_cast<DegradationLevel>(static_cast<int>(level) - 1);
+                lastChange = now;
+                return true;
+            }
+
+            return false;
+        }
+
+        DegradationLevel getLevel() const { return level; }
+
+        static std::string levelName(DegradationLevel level) {
+            switch (level) {
+                case DegradationLevel::FullWaveforms:    return "full waveforms";
+                case DegradationLevel::TrimmedWaveforms: return "trimmed waveforms";
+                case DegradationLevel::FeaturesOnly:     return "features only";
+                case DegradationLevel::CountsOnly:       return "counts only";
+            }
+            return "unknown";
+        }
+
+    private:
+        DegradationLevel level = DegradationLevel::FullWaveforms;
+        Long64_t lastChange = 0;
+
+        // limits
+        size_t highWater = 20000;
+        size_t lowWater = 2000;
+        Long64_t maxLag = 5000000000LL;
+        Long64_t holdTime = 10000000000LL;
+};
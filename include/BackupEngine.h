@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <RtypesCore.h>
+#include <Checksum.h>
+#include <TaskScheduler.h>
+#include <TrackedFile.h>
+
+class CollectorConfig;
+class ErrorHandler;
+
+namespace fs = std::filesystem;
+
+// copies output files to the backup directories while they are written
+// full chunks are streamed as soon as they are on disk (<dest>.part), every chunk is read once,
+// hashed and written to all destinations in parallel; when the file is closed only the chunks its
+// writer changed again are read and compared (all of them if the changes are not known), then the
+// rest is copied; the checksum of the file is combined from the chunk hashes, every copy is read
+// back once, compared with it, renamed and listed with the checksum in the manifest.json of its folder
+// pending copies are kept in a queue file and retried until they succeed
+class BackupEngine {
+    public:
+
+        // constructor and destructor
+        BackupEngine(
+            std::shared_ptr<CollectorConfig> cc,
+            ErrorHandler *err,
+            TaskScheduler *ts
+        );
+        ~BackupEngine();
+
+        // load the queue of the last run and start copying
+        void start();
+        void stop();
+
+        // stream a file that is written (relative is its path in every backup directory,
+        // rewrites are the ranges the writer changes again, nullptr if not known)
+        void track(const fs::path& source, const fs::path& relative, std::shared_ptr<RewriteLog> rewrites = nullptr);
+
+        // file is closed, copy the rest (also files that were not tracked)
+        void complete(const fs::path& source, const fs::path& relative);
+
+        // file was removed, forget its copy
+        void cancel(const fs::path& source);
+
+        // copy all closed files now (without bandwidth limit), failed copies stay queued
+        void drain();
+
+        // number of files not yet backed up
+        size_t getPending();
+
+    private:
+
+        struct Job {
+            fs::path source;
+            std::vector<fs::path> dests;
+            std::atomic<bool> closed = false;
+            std::atomic<bool> cancelled = false;
+            bool done = false;
+
+            // copied chunks and their hashes
+            std::vector<uint64_t> hashes;
+
+            // ranges changed by the writer, chunks to compare once the file is closed (before rechecked done)
+            std::shared_ptr<RewriteLog> rewrites;
+            std::vector<size_t> stale;
+            bool staleKnown = false;
+            size_t rechecked = 0;
+
+            // retry with growing delay
+            int failures = 0;
+            std::chrono::steady_clock::time_point retryTime;
+        };
+
+        // copy of one timer period
+        void step();
+
+        // copy jobs till budget is used up, false if nothing could be copied
+        bool copy(Long64_t& budget, bool closedOnly);
+
+        // copy part of a job, returns false on error (budget is reduced by the bytes read)
+        bool copyJob(Job& job, Long64_t& budget);
+        void fail(Job& job, const std::string& message);
+
+        // a destination failed, it is copied again from the start by its own job
+        void failDest(Job& job, size_t index, const std::string& message);
+
+        // sync a copy, read it back, compare the checksum of its chunks and rename it
+        bool finishCopy(int fd, const fs::path& dest, Long64_t size, uint64_t checksum, std::string& error);
+
+        // add a copy to the manifest.json of its folder
+        void writeManifest(const fs::path& dest, Long64_t size, uint64_t checksum);
+
+        Job* findJob(const fs::path& source);
+
+        // path of a file in every backup directory
+        std::vector<fs::path> destinations(const fs::path& relative);
+
+        // queue file in the working directory
+        void saveQueue();
+        void loadQueue();
+        fs::path queuePath;
+
+        // jobs (list, pointers stay valid while copying)
+        std::list<Job> jobs;
+        std::mutex mtx;
+
+        // one copy at a time (timer or drain)
+        std::mutex copyMtx;
+
+        // bandwidth limit
+        double tokens = 0;
+        std::chrono::steady_clock::time_point lastStep;
+
+        static constexpr Long64_t chunkSize = 4 * 1048576;
+        std::vector<char> buffer;
+
+        TimerID timer = 0;
+
+        // config
+        std::shared_ptr<CollectorConfig> CC;
+
+        // executor of the copies
+        TaskScheduler *TS;
+
+        // error handling
+        ErrorHandler *ERR;
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <TTree.h>
+
+// sudden rise of the event rate on one timescale
+struct BurstAlarm {
+    Long64_t time;          // end of the window [ns]
+    Double_t timescale;     // window length [s]
+    Long64_t counts;        // events in the window
+    Double_t expected;      // expected events from the baseline rate
+    Double_t significance;  // Poisson probability of at least counts, as one-sided Gaussian sigma
+};
+
+// sliding windows on the event timestamps at several timescales,
+// constant memory and constant time per event
+class BurstDetector {
+    public:
+
+        // set timescales [s], alarm threshold [sigma] and time to learn the baseline rate [s]
+        void configure(const std::vector<double>& timescales, double significance_, double baselineTime_) {
+            significance = significance_;
+            baselineTime = std::max(baselineTime_, 1.0);
+
+            scales.clear();
+            for (double timescale : timescales) {
+                if (timescale <= 0) continue;
+                Scale scale;
+                scale.timescale = timescale;
+                scale.bucketLength = static_cast<Long64_t>(timescale * 1e9 / nBuckets);
+                scale.alpha = std::min(timescale / nBuckets / baselineTime, 1.0);
+                scales.push_back(scale);
+            }
+        }
+
+        // start without history
+        void reset() {
+            for (Scale& scale : scales) {
+                scale.buckets.fill(0);
+                scale.current = 0;
+                scale.bucketStart = -1;
+                scale.baselineRate = 0;
+                scale.learned = 0;
+                scale.holdoff = 0;
+            }
+        }
+
+        // add event time [ns], onAlarm is called for every alarm
+        template <typename F>
+        void addEvent(Long64_t time, F&& onAlarm) {
+            for (Scale& scale : scales) {
+
+                // first event
+                if (scale.bucketStart < 0) scale.bucketStart = time;
+
+                // close finished buckets
+                Long64_t elapsed = (time - scale.bucketStart) / scale.bucketLength;
+                if (elapsed > 0) advance(scale, elapsed, onAlarm);
+
+                scale.buckets[scale.current]++;
+            }
+        }
+
+    private:
+        // sub-buckets per window, the window slides by one bucket
+        static constexpr int nBuckets = 4;
+
+        struct Scale {
+            double timescale = 1;
+            Long64_t bucketLength = 1;
+            double alpha = 0;                   // weight of a bucket in the baseline rate
+
+            std::array<Long64_t,nBuckets> buckets = {};
+            int current = 0;
+            Long64_t bucketStart = -1;
+
+            double baselineRate = 0;            // Hz
+            double learned = 0;                 // s of data in the baseline
+            int holdoff = 0;                    // buckets till the next alarm
+        };
+
+        template <typename F>
+        void advance(Scale& scale, Long64_t elapsed, F&& onAlarm) {
+
+            // only the last buckets of a long gap are relevant
+            Long64_t steps = std::min<Long64_t>(elapsed, nBuckets);
+            Long64_t skipped = elapsed - steps;
+
+            for (Long64_t step = 0; step < steps; step++) {
+
+                // window of the last buckets
+                Long64_t counts = 0;
+                for (Long64_t bucket : scale.buckets) counts += bucket;
+
+                double expected = scale.baselineRate * scale.timescale;
+                bool alarm = false;
+
+                // alarm only with a learned baseline
+                if (scale.holdoff > 0) {
+                    scale.holdoff--;
+                }
+                else if (scale.learned >= baselineTime && expected > 0 && counts > expected) {
+                    double sigma = poissonSigma(counts, expected);
+                    if (sigma > significance) {
+                        Long64_t windowEnd = scale.bucketStart + scale.bucketLength;
+                        onAlarm(BurstAlarm{windowEnd, scale.timescale, counts, expected, sigma});
+                        scale.holdoff = nBuckets;
+                        alarm = true;
+                    }
+                }
+
+                // bursts are not learned into the baseline
+                if (!alarm && scale.holdoff == 0) {
+                    double bucketTime = scale.bucketLength / 1e9;
+                    double bucketRate = scale.buckets[scale.current] / bucketTime;
+
+                    // plain average while learning, then exponential
+                    double weight = std::max(scale.alpha, bucketTime / (scale.learned + bucketTime));
+                    scale.baselineRate += weight * (bucketRate - scale.baselineRate);
+                    scale.learned += bucketTime;
+                }
+
+                // next bucket
+                scale.current = (scale.current + 1) % nBuckets;
+                scale.buckets[scale.current] = 0;
+                scale.bucketStart += scale.bucketLength;
+            }
+
+            // empty buckets of a long gap lower the baseline
+            if (skipped > 0) {
+                scale.baselineRate *= std::pow(1 - scale.alpha, static_cast<double>(skipped));
+                scale.learned += skipped * scale.bucketLength / 1e9;
+                scale.bucketStart += skipped * scale.bucketLength;
+            }
+        }
+
+        // significance of at least counts events with expected mean (few counts on short timescales)
+        static double poissonSigma(Long64_t counts, double expected) {
+
+            // log P(X >= k) = log P(k, mu), series of the regularized gamma function (converges for k > mu)
+            double k = static_cast<double>(counts);
+            double sum = 1, term = 1;
+            for (int n = 1; n < 100000 && term > 1e-16 * sum; n++) {
+                term *= expected / (k + n);
+                sum += term;
+            }
+            double logP = k * std::log(expected) - expected - std::lgamma(k + 1) + std::log(sum);
+            if (logP >= std::log(0.5)) return 0;
+
+            // z with Q(z) = P, start from the asymptotic expansion, refine with Newton steps on log Q
+            double t = -2 * logP;
+            double z = std::sqrt(std::max(t - std::log(t) - std::log(2 * M_PI), 0.0));
+            for (int i = 0; i < 4 && z < 37; i++) {
+                double q = 0.5 * std::erfc(z / std::sqrt(2.0));
+                double density = std::exp(-0.5 * z * z) / std::sqrt(2 * M_PI);
+                z += (std::log(q) - logP) * q / density;
+            }
+            return z;
+        }
+
+        // config
+        double significance = 5;
+        double baselineTime = 600;
+
+        std::vector<Scale> scales;
+};
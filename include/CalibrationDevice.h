@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// device steps needed by the calibration (digitizer or simulation)
+class CalibrationDevice {
+    public:
+        virtual ~CalibrationDevice() = default;
+
+        // channel settings
+        virtual bool setChannelDCOffset(int channel, uint16_t dcOffset) = 0;
+        virtual bool setChannelTriggerThreshold(int channel, uint16_t threshold) = 0;
+
+        // mean and rms of the samples of software triggered events
+        virtual bool measureBaseline(int channel, int nTriggers, double& mean, double& rms) = 0;
+
+        // self triggers of a single channel within the measuring time [s]
+        virtual bool countTriggers(int channel, double seconds, uint64_t& triggers, double& liveTime) = 0;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+
+#include <nlohmann/json.hpp>
+#include <CalibrationDevice.h>
+
+class CollectorConfig;
+class DigitizerConfig;
+class ErrorHandler;
+
+// finds DC offsets and trigger thresholds for every active channel
+class Calibrator {
+    public:
+
+        // constructor
+        Calibrator(
+            std::shared_ptr<CollectorConfig> cc,
+            std::shared_ptr<DigitizerConfig> dc,
+            ErrorHandler *err
+        );
+
+        // calibrate all active channels and write the results to json
+        bool run(CalibrationDevice& device, bool simulated);
+
+    private:
+
+        // point of the rate-versus-threshold curve
+        struct CurvePoint {
+            uint16_t threshold;
+            uint64_t triggers;
+            double rate;
+            double rateError;
+        };
+
+        // result of one channel
+        struct ChannelResult {
+            uint16_t dcOffset = 0;
+            double baseline = 0;
+            double baselineRMS = 0;
+            uint16_t threshold = 0;
+            std::vector<CurvePoint> curve;
+        };
+
+        // calibration steps
+        bool calibrateBaseline(CalibrationDevice& device, int channel, ChannelResult& result);
+        bool sweepThresholds(CalibrationDevice& device, int channel, ChannelResult& result);
+
+        // write results
+        bool writeResults(const std::array<ChannelResult,3>& results, bool simulated);
+
+        // config
+        std::shared_ptr<CollectorConfig> CC;
+        std::shared_ptr<DigitizerConfig> DC;
+
+        // error handling
+        ErrorHandler *ERR;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// xxHash64 (fast non-cryptographic hash) of backup chunks and files
+class Checksum {
+    public:
+
+        static uint64_t xxHash64(const void* input, size_t length, uint64_t seed = 0) {
+            const uint8_t* p = static_cast<const uint8_t*>(input);
+            const uint8_t* end = p + length;
+            uint64_t hash;
+
+            // four lanes of 8 bytes
+            if (length >= 32) {
+                const uint8_t* limit = end - 32;
+                uint64_t v1 = seed + prime1 + prime2;
+                uint64_t v2 = seed + prime2;
+                uint64_t v3 = seed;
+                uint64_t v4 = seed - prime1;
+                do {
+                    v1 = round(v1, read64(p));
+                    v2 = round(v2, read64(p + 8));
+                    v3 = round(v3, read64(p + 16));
+                    v4 = round(v4, read64(p + 24));
+                    p += 32;
+                } while (p <= limit);
+
+                hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+                hash = merge(hash, v1);
+                hash = merge(hash, v2);
+                hash = merge(hash, v3);
+                hash = merge(hash, v4);
+            } else {
+                hash = seed + prime5;
+            }
+            hash += length;
+
+            return finish(hash, p, end);
+        }
+
+        // checksum of a file from the xxHash64 of its chunks (in order, as little endian array)
+        static uint64_t combine(const std::vector<uint64_t>& hashes) {
+            return xxHash64(hashes.data(), hashes.size() * sizeof(uint64_t));
+        }
+
+        // 16 hex digits
+        static std::string hex(uint64_t hash) {
+            static const char digits[] = "0123456789abcdef";
+            std::string text(16, '0');
+            for (int i = 15; i >= 0; i--, hash >>= 4) text[i] = digits[hash & 0xf];
+            return text;
+        }
+
+    private:
+        static constexpr uint64_t prime1 = 11400714785074694791ULL;
+        static constexpr uint64_t prime2 = 14029467366897019727ULL;
+        static constexpr uint64_t prime3 = 1609587929392839161ULL;
+        static constexpr uint64_t prime4 = 9650029242287828579ULL;
+        static constexpr uint64_t prime5 = 2870177450012600261ULL;
+
+        // bytes after the last stripe and avalanche
+        static uint64_t finish(uint64_t hash, const uint8_t* p, const uint8_t* end) {
+            for (; p + 8 <= end; p += 8) {
+                hash ^= round(0, read64(p));
+                hash = rotl(hash, 27) * prime1 + prime4;
+            }
+            if (p + 4 <= end) {
+                hash ^= static_cast<uint64_t>(read32(p)) * prime1;
+                hash = rotl(hash, 23) * prime2 + prime3;
+                p += 4;
+            }
+            for (; p < end; p++) {
+                hash ^= *p * prime5;
+                hash = rotl(hash, 11) * prime1;
+            }
+
+            hash ^= hash >> 33;
+            hash *= prime2;
+            hash ^= hash >> 29;
+            hash *= prime3;
+            hash ^= hash >> 32;
+
+            return hash;
+        }
+
+        static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+        static uint64_t round(uint64_t acc, uint64_t input) {
+            acc += input * prime2;
+            acc = rotl(acc, 31);
+            return acc * prime1;
+        }
+
+        static uint64_t merge(uint64_t acc, uint64_t value) {
+            acc ^= round(0, value);
+            return acc * prime1 + prime4;
+        }
+
+        // little endian reads
+        static uint64_t read64(const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }
+        static uint32_t read32(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; }
+};
@@ -2,6 +2,30 @@
 #pragma once
 
 #include <filesystem>
+#include <vector>
+
+#include <SPSCQueue.h>
+
+// which waveforms are kept if the acquisition limit is enabled
+enum class AcquisitionLimitMode {
+    FirstEvents,    // first events of the file
+    TimeUniform     // events spread uniformly over the file period
+};
+
+// compression of the ROOT files
+enum class CompressionAlgorithm {
+    ZLIB,
+    LZMA,
+    LZ4,
+    ZSTD
+};
+
+// storage of data1, data2 and data3
+enum class OutputFormat {
+    TTree,
+    RNTuple,
+    RawLog      // raw event log segments, converted to ROOT offline
+};
 
 struct CollectorConfig {
     private:
@@ -19,10 +43,103 @@ struct CollectorConfig {
         // Directories
         std::string workingDir = expandHome("~/TancaData/").string();
         std::string backupDir  = expandHome("~/TancaBackup/").string();
+        std::vector<std::string> backupDirs;   // more backup destinations (second disk, removable drive)
 
         bool enableBackup = false;
+        bool backupWaveforms = true;            // also back up waveform files and raw segments
+        double backupMBps = 20;                 // bandwidth of the backup copies (0 = unlimited)
         bool detailedLog = false;
 
+        // ROOT output
+        OutputFormat outputFormat = OutputFormat::TTree;
+        CompressionAlgorithm compressionAlgorithm = CompressionAlgorithm::ZSTD;
+        int compressionLevel = 5;               // 1 (fast) ... 9 (small)
+        int basketSize = 65536;                 // bytes per branch buffer
+        double autoFlushMB = 30;                // write baskets every MB of data, 0 = ROOT default
+        bool enableImplicitMT = false;          // compress baskets in parallel
+        int implicitMTThreads = 0;              // ROOT worker threads, 0 = number of cores
+        int bufferMergerFillers = 0;            // parallel fillers of data1 into one file, 0 = off
+        int bufferMergerBatch = 256;            // events per filler task
+        int rawSegmentMB = 1024;                // size of one raw log segment
+        int rawBufferMB = 8;                    // write block of the raw log
+        bool rawDirectIO = false;               // bypass the page cache (O_DIRECT)
+        bool rawWaveformCodec = true;           // delta and bit-pack coded waveforms
+        bool splitWaveforms = false;            // data1 in <file>_waveforms.root, friend of features
+
+        // file rotation (policies are combined, the first one reached closes the file)
+        double rotationPeriod = 3600;           // s, aligned to UTC (0 = off)
+        double rotationMaxMB = 0;               // size of the file(s) on disk (0 = off)
+        int rotationMaxEvents = 0;              // digitizer events (0 = off)
+        double rotationPrepareLead = 60;        // open the next file in the background seconds before the rotation
+        bool partitionByEventTime = false;      // files per rotationPeriod slot of the event time (size and event limits unused)
+        double partitionGrace = 10;             // s, a partition stays open for late events after its slot
+
+        // crash safety (tree headers written, file recoverable up to the last checkpoint)
+        double checkpointInterval = 10;         // s (0 = off)
+        double checkpointMB = 0;                // written bytes per tree (0 = ROOT default AutoSave)
+
+        // queue between digitizer readout and writer
+        int digitizerQueueCapacity = 8192;      // events
+        QueueFullPolicy digitizerQueuePolicy = QueueFullPolicy::Block;
+
         bool enableAcquisitionLimit = false;
         int acquisitionLimit = 0;
+        AcquisitionLimitMode acquisitionLimitMode = AcquisitionLimitMode::FirstEvents;
+        int acquisitionLimitBuckets = 60;       // time buckets per file (TimeUniform)
+
+        // flight recorder (full waveforms of the last seconds)
+        bool enableFlightRecorder = false;
+        int flightRecorderSeconds = 10;
+        int flightRecorderMaxEvents = 10000;
+        double flightRecorderRateLimit = 0;     // dump if rate [Hz] exceeds limit, 0 = off
+
+        // sliding window rates from the event time stamps
+        std::vector<double> rateWindows = {10, 60, 600};   // window lengths [s], first is stored in data2
+        int rateBuckets = 50;                   // time buckets per window
+
+        // environment of the digitizer events
+        double environmentWait = 3;             // s an event waits for the next Arduino reading (interpolation)
+
+        // reduce stored data if the writer falls behind
+        bool enableBackpressure = true;
+        int backpressureHighWater = 6000;       // events in queue to step down (at most 75 % of the queue)
+        int backpressureLowWater = 800;         // events in queue to step up (at most 10 % of the queue)
+        double backpressureMaxLag = 5;          // writer lag [s] to step down
+        double backpressureHoldTime = 10;       // minimum time [s] per level
+        int trimmedSamples = 128;               // samples kept per channel when trimmed
+
+        // memory budget of queues, buffers and ROOT baskets
+        int memoryBudget = 1024;                // MB, 0 = unlimited
+        double memoryFlushFraction = 0.8;       // flush baskets above this fraction of the budget
+        double memoryReportInterval = 60;       // s between memory reports in the log
+
+        // adjust trigger thresholds to hold a target rate per channel
+        bool enableThresholdControl = false;
+        double targetTriggerRate = 50;          // Hz per channel
+        double thresholdControlTolerance = 0.2; // relative deviation before adjusting
+        int thresholdControlMin = 1000;         // 0...4095
+        int thresholdControlMax = 4000;         // 0...4095
+        int thresholdControlStep = 10;          // ADC counts per adjustment
+        double thresholdControlInterval = 10;   // s
+
+        // calibration of DC offset and trigger threshold
+        bool simulateDigitizer = false;         // calibrate against a simulated digitizer
+        double calibrationBaselineTarget = 2048;    // ADC counts
+        double calibrationBaselineTolerance = 2;    // ADC counts
+        int calibrationBaselineTriggers = 20;       // software triggers per baseline
+        double calibrationThresholdStart = 5;       // ADC counts from baseline
+        double calibrationThresholdEnd = 400;       // ADC counts from baseline
+        int calibrationThresholdSteps = 20;
+        double calibrationMeasureTime = 0.2;        // s per threshold
+
+        // alarms on sudden rate jumps
+        bool enableBurstDetection = true;
+        std::vector<double> burstTimescales = {0.1, 1, 10};    // window lengths [s]
+        double burstSignificance = 5;           // alarm threshold [sigma]
+        double burstBaselineTime = 600;         // time to learn the normal rate [s]
+        bool burstDumpFlightRecorder = true;    // dump flight recorder on alarm
+
+        // shared executor of all pipeline stages
+        int schedulerThreads = 0;               // worker threads, 0 = number of cores
+        double readoutInterval = 0.1;           // s between digitizer readouts
 };
\ No newline at end of file
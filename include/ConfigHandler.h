@@ -19,14 +19,120 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(
     active
 )
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(
-    CollectorConfig, 
-    workingDir,
-    backupDir,
-    enableBackup,
-    enableAcquisitionLimit,
-    acquisitionLimit
-)
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    AcquisitionLimitMode, {
+    {AcquisitionLimitMode::FirstEvents, "first"},
+    {AcquisitionLimitMode::TimeUniform, "uniform"}
+})
+
+NLOHMANN_JSON_SERIALIZE_ENUM(
+    QueueFullPolicy, {
+    {QueueFullPolicy::Block, "block"},
+    {QueueFullPolicy::DropNewest, "dropNewest"},
+    {QueueFullPolicy::DropOldest, "dropOldest"}
+})
+
+NLOHMANN_JSON_SERIALIZE_ENUM(CompressionAlgorithm, {
+    {CompressionAlgorithm::ZLIB, "zlib"},
+    {CompressionAlgorithm::LZMA, "lzma"},
+    {CompressionAlgorithm::LZ4, "lz4"},
+    {CompressionAlgorithm::ZSTD, "zstd"}
+})
+
+NLOHMANN_JSON_SERIALIZE_ENUM(OutputFormat, {
+    {OutputFormat::TTree, "ttree"},
+    {OutputFormat::RNTuple, "rntuple"},
+    {OutputFormat::RawLog, "raw"}
+})
+
+// members of the CollectorConfig in two groups (NLOHMANN_JSON_PASTE takes at most 63 arguments)
+#define COLLECTOR_CONFIG_OUTPUT_MEMBERS \
+    workingDir, \
+    backupDir, \
+    backupDirs, \
+    enableBackup, \
+    backupWaveforms, \
+    backupMBps, \
+    outputFormat, \
+    compressionAlgorithm, \
+    compressionLevel, \
+    basketSize, \
+    autoFlushMB, \
+    enableImplicitMT, \
+    implicitMTThreads, \
+    bufferMergerFillers, \
+    bufferMergerBatch, \
+    rawSegmentMB, \
+    rawBufferMB, \
+    rawDirectIO, \
+    rawWaveformCodec, \
+    splitWaveforms, \
+    rotationPeriod, \
+    rotationMaxMB, \
+    rotationMaxEvents, \
+    rotationPrepareLead, \
+    partitionByEventTime, \
+    partitionGrace, \
+    checkpointInterval, \
+    checkpointMB
+
+#define COLLECTOR_CONFIG_PROCESSING_MEMBERS \
+    digitizerQueueCapacity, \
+    digitizerQueuePolicy, \
+    enableAcquisitionLimit, \
+    acquisitionLimit, \
+    acquisitionLimitMode, \
+    acquisitionLimitBuckets, \
+    enableFlightRecorder, \
+    flightRecorderSeconds, \
+    flightRecorderMaxEvents, \
+    flightRecorderRateLimit, \
+    rateWindows, \
+    rateBuckets, \
+    environmentWait, \
+    enableBackpressure, \
+    backpressureHighWater, \
+    backpressureLowWater, \
+    backpressureMaxLag, \
+    backpressureHoldTime, \
+    trimmedSamples, \
+    memoryBudget, \
+    memoryFlushFraction, \
+    memoryReportInterval, \
+    enableThresholdControl, \
+    targetTriggerRate, \
+    thresholdControlTolerance, \
+    thresholdControlMin, \
+    thresholdControlMax, \
+    thresholdControlStep, \
+    thresholdControlInterval, \
+    simulateDigitizer, \
+    calibrationBaselineTarget, \
+    calibrationBaselineTolerance, \
+    calibrationBaselineTriggers, \
+    calibrationThresholdStart, \
+    calibrationThresholdEnd, \
+    calibrationThresholdSteps, \
+    calibrationMeasureTime, \
+    enableBurstDetection, \
+    burstTimescales, \
+    burstSignificance, \
+    burstBaselineTime, \
+    burstDumpFlightRecorder, \
+    schedulerThreads, \
+    readoutInterval
+
+inline void to_json(nlohmann::json& nlohmann_json_j, const CollectorConfig& nlohmann_json_t) {
+    NLOHMANN_JSON_EXPAND(NLOHMANN_JSON_PASTE(NLOHMANN_JSON_TO, COLLECTOR_CONFIG_OUTPUT_MEMBERS))
+    NLOHMANN_JSON_EXPAND(NLOHMANN_JSON_PASTE(NLOHMANN_JSON_TO, COLLECTOR_CONFIG_PROCESSING_MEMBERS))
+}
+
+// missing keys keep their default value (older config files)
+inline void from_json(const nlohmann::json& nlohmann_json_j, CollectorConfig& nlohmann_json_t) {
+    const CollectorConfig nlohmann_json_default_obj{};
+    NLOHMANN_JSON_EXPAND(NLOHMANN_JSON_PASTE(NLOHMANN_JSON_FROM_WITH_DEFAULT, COLLECTOR_CONFIG_OUTPUT_MEMBERS))
+    NLOHMANN_JSON_EXPAND(NLOHMANN_JSON_PASTE(NLOHMANN_JSON_FROM_WITH_DEFAULT, COLLECTOR_CONFIG_PROCESSING_MEMBERS))
+}
 
 class ConfigHandler {
     public:
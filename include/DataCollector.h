@@ -1,12 +1,26 @@
 #pragma once
 
 #include <chrono>
+#include <deque>
 #include <ctime>
 
 #include <Arduino.h>
 #include <DigitizerWrapper.h>
 #include <RootTreeWriter.h>
-#include <RateCalculator.h>
+#include <RateEstimator.h>
+#include <FlightRecorder.h>
+#include <FeatureExtractor.h>
+#include <AcquisitionSampler.h>
+#include <RotationPolicy.h>
+#include <BackpressureController.h>
+#include <EnvironmentCache.h>
+#include <BurstDetector.h>
+#include <ThresholdController.h>
+#include <Calibrator.h>
+#include <SimulatedDigitizer.h>
+#include <DataNotifier.h>
+#include <TaskScheduler.h>
+#include <MemoryAccountant.h>
 #include <ConfigHandler.h>
 #include <CollectorConfig.h>
 
@@ -30,6 +44,7 @@ class DataCollector {
             ErrorHandler *err,
             std::shared_ptr<TimeTagHandler> tth
         );
+        ~DataCollector();
 
         // steering acquisition
         bool open();
@@ -43,26 +58,106 @@ class DataCollector {
         // wait till Backup is finished
         void joinRTWBackup();
 
+        // write waveforms of the flight recorder to file
+        void dumpFlightRecorder();
+
+        // rates of all windows at the end of the last processing run (any thread)
+        std::vector<RateValue> getRates();
+
+        // calibrate DC offsets and thresholds in background
+        bool startCalibration();
+        bool getCalibrating() { return isCalibrating.load(); }
+        void joinCalibration();
+
     private:
 
         bool startReading();
         bool stopReading();
 
-        void readingLoop();
+        // processing task, scheduled on new data and by the housekeeping timer
+        void processingTask();
+        bool processQueues();
+
+        // helper for processQueues
+        static Long64_t getNow();
+        void startFilePeriod(Long64_t now);
+        void updatePartition(Long64_t watermark);
+        void recordLevel(Long64_t ts, size_t queueDepth, Long64_t lag);
+
+        // write features of the held events up to time with their environment
+        void writeFeatures(Long64_t upTo);
+        bool updateMemory();
+        void onBurstAlarm(const BurstAlarm& alarm);
+
+        void calibrationLoop();
+
+        // cut waveforms around the trigger position
+        void trimWaveforms(DigitizerData& DData);
 
         // status
         std::atomic<bool> isReading = false;
-        std::thread readData;
+        std::atomic<bool> isStopping = false;   // error, stop is submitted (no more processing)
+        std::mutex readingMtx;      // held while processing
+
+        // schedules processingTask on new data
+        DataNotifier NT;
+        TimerID housekeepingTimer = 0;
+        static constexpr std::chrono::seconds housekeepingInterval{1};
+
+        // state of the processing
+        bool nextFilePrepared = false;
+        Long64_t newestEventTime = 0;       // newest processed digitizer event
+        Long64_t partitionStart = 0;        // partition of the acquisition limit
+        bool thresholdControlStarted = false;
+        bool rateAboveLimit = false;        // flight recorder dump of the rate spike requested
+        int arduinoEventCounter = 0;
+        int digitizerEventCounter = 0;
+        uint64_t loopCount = 0;
+        Long64_t nextMemoryReport = 0;
+        Long64_t nextCheckpoint = 0;
+
+        // features wait for the Arduino reading after the event
+        struct HeldFeatures {
+            Long64_t time;
+            ULong64_t eventID;
+            DigitizerFeatures features;
+        };
+        std::deque<HeldFeatures> heldFeatures;
+        static constexpr size_t maxHeldFeatures = 65536;
+
+        // memory of the large allocation sites
+        MemoryAccountant MA;
+        size_t memQueue, memFlightRecorder, memBaskets;
+
+        // rates for other threads
+        std::vector<RateValue> rates;
+        std::mutex rateMtx;
+
+        std::atomic<bool> isCalibrating = false;
+        TaskFuture calibration;
 
         bool isOpen = false;
+
+        // executor of all pipeline stages (created before the components that use it)
+        TaskScheduler TS;
         
         // Member Objects
         Arduino AD;
         DigitizerWrapper DW;
         RootTreeWriter RTW;
-        RateCalculator RC;
+        RateEstimator RE;
+        FlightRecorder FR;
+        FeatureExtractor FE;
+        AcquisitionSampler AS;
+        std::unique_ptr<RotationPolicy> RP;
+        BackpressureController BP;
+        EnvironmentCache EC;
+        BurstDetector BD;
+        ThresholdController TC;
+        Calibrator CAL;
 
         std::shared_ptr<CollectorConfig> CC;
+        std::shared_ptr<DigitizerConfig> DC;
 
         // error handling
         bool boolret;
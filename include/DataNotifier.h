@@ -0,0 +1,25 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+// schedules the consumer when a producer added data
+class DataNotifier {
+    public:
+
+        // consumer to schedule (set before the producers start)
+        void setCallback(std::function<void()> cb) { callback = std::move(cb); }
+
+        // signal new data (cheap if the consumer is already scheduled)
+        void notify() {
+            if (pending.exchange(true)) return;
+            if (callback) callback();
+        }
+
+        // consumer finished, the next signal schedules it again
+        void done() { pending.store(false); }
+
+    private:
+        std::atomic<bool> pending = false;
+        std::function<void()> callback;
+};
@@ -7,9 +7,9 @@ struct DigitizerData {
     DigitizerData(
         uint64_t id_,
         Double_t et_, 
-        std::vector<Double_t> ch0_, 
-        std::vector<Double_t> ch1_, 
-        std::vector<Double_t> ch2_
+        std::vector<UShort_t> ch0_, 
+        std::vector<UShort_t> ch1_, 
+        std::vector<UShort_t> ch2_
     )
       : eventID(id_),
         eventTime(et_), 
@@ -24,6 +24,6 @@ struct DigitizerData {
     // time tag
     Long64_t eventTime;
 
-    // channel rows
-    std::vector<Double_t> ch0, ch1, ch2;
+    // channel rows (raw ADC samples)
+    std::vector<UShort_t> ch0, ch1, ch2;
 };
\ No newline at end of file
@@ -9,19 +9,22 @@
 #include <DigitizerData.h>
 #include <CollectorConfig.h>
 #include <DigitizerConfig.h>
-#include <TSQueue.h>
+#include <SPSCQueue.h>
 #include <ConfigHandler.h>
 #include <TimeTagHandler.h>
 #include <ErrorHandler.h>
+#include <CalibrationDevice.h>
+#include <TaskScheduler.h>
 
-class DigitizerWrapper {
+class DigitizerWrapper : public CalibrationDevice {
     public:
         // constructor
         DigitizerWrapper(
             std::shared_ptr<CollectorConfig> cc,
             std::shared_ptr<DigitizerConfig> dc,
             ErrorHandler *err,
-            std::shared_ptr<TimeTagHandler> tth
+            std::shared_ptr<TimeTagHandler> tth,
+            TaskScheduler *ts
         );
 
         // set configuration to digitizer
@@ -36,14 +39,42 @@ class DigitizerWrapper {
 
         // get data from digitizer
         std::optional<DigitizerData> getDigitizerData() { return q.pop(); };
+
+        // number of events waiting in the queue
+        size_t getQueueSize() { return q.size(); };
+
+        // wake consumer on new events
+        void setNotifier(DataNotifier* notifier) { q.setNotifier(notifier); };
+
+        // change trigger threshold between two readout blocks
+        void requestTriggerThreshold(int channel, uint16_t threshold);
+
+        // thresholds set in the digitizer (the config keeps the configured ones)
+        std::array<uint16_t,3> getTriggerThresholds();
+
+        // calibration steps (acquisition must be stopped)
+        bool setChannelDCOffset(int channel, uint16_t dcOffset) override;
+        bool setChannelTriggerThreshold(int channel, uint16_t threshold) override;
+        bool measureBaseline(int channel, int nTriggers, double& mean, double& rms) override;
+        bool countTriggers(int channel, double seconds, uint64_t& triggers, double& liveTime) override;
         
     private:
         // status
         std::atomic<bool> isCollecting = false;
 
-        // collectingLoop
-        void collectingLoop();
-        std::thread collectDigitizerData;
+        // periodic readout task, returns false on error
+        bool readout();
+        std::atomic<TimerID> readoutTimer = 0;
+        uint64_t loopCount = 0;
+        uint64_t nextEventID = 0;
+
+        // apply requested trigger thresholds
+        bool applyPendingThresholds();
+        std::array<std::atomic<int>,3> pendingThreshold = {-1, -1, -1};
+        std::array<std::atomic<uint16_t>,3> appliedThreshold = {0, 0, 0};
+
+        // bitmask of the active channels
+        uint32_t activeChannelMask();
 
         // Tree variables
         int eventID;
@@ -61,8 +92,8 @@ class DigitizerWrapper {
 
         CAEN_DGTZ_UINT16_EVENT_t* evt;
 
-        // queue for exchange
-        TSQueue<DigitizerData> q;
+        // bounded queue for exchange
+        SPSCQueue<DigitizerData> q;
 
         // configuration
         std::shared_ptr<DigitizerConfig> DC;
@@ -71,6 +102,9 @@ class DigitizerWrapper {
         // time stamp handling
         std::shared_ptr<TimeTagHandler> TTH;
 
+        // executor of the readout
+        TaskScheduler *TS;
+
         // error handling
         CAEN_DGTZ_ErrorCode ret;
         ErrorHandler *ERR;
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <deque>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include <TTree.h>
+
+// environment at the time of a digitizer event (NaN without readings)
+struct EnvironmentContext {
+    Double_t pressure = std::numeric_limits<Double_t>::quiet_NaN();        // mbar
+    Double_t temperature = std::numeric_limits<Double_t>::quiet_NaN();     // Arduino sensor
+    Long64_t data2Entry = -1;       // last data2 entry before the event, -1 if none
+};
+
+// keeps the recent Arduino readings to attach them to digitizer events
+class EnvironmentCache {
+    public:
+
+        // remove all readings
+        void clear() { readings.clear(); }
+
+        // add reading (in time order) with its entry in data2
+        void addReading(Long64_t time, Double_t pressure, Double_t temperature, Long64_t data2Entry) {
+            readings.push_back({time, pressure, temperature, data2Entry});
+            if (readings.size() > maxReadings) readings.pop_front();
+        }
+
+        // time of the newest reading, events up to it can be interpolated
+        Long64_t getLatest() const {
+            return readings.empty() ? std::numeric_limits<Long64_t>::min() : readings.back().time;
+        }
+
+        // the entry in data2 restarts with every new file
+        void resetEntries() {
+            for (Reading& reading : readings) reading.data2Entry = -1;
+        }
+
+        // interpolate between the readings around the event time,
+        // the last reading is held if no newer one is available
+        // (data2 entries of readings before entriesFrom belong to another file)
+        EnvironmentContext get(Long64_t time, Long64_t entriesFrom = std::numeric_limits<Long64_t>::min()) const {
+
+            EnvironmentContext context;
+            if (readings.empty()) return context;
+
+            // first reading after the event
+            auto next = std::upper_bound(
+                readings.begin(), readings.end(), time,
+                [](Long64_t t, const Reading& reading) { return t < reading.time; }
+            );
+
+            // before the first reading
+            if (next == readings.begin()) {
+                context.pressure = next->pressure;
+                context.temperature = next->temperature;
+                return context;
+            }
+
+            auto previous = std::prev(next);
+            if (previous->time >= entriesFrom) context.data2Entry = previous->data2Entry;
+
+            // after the last reading
+            if (next == readings.end()) {
+                context.pressure = previous->pressure;
+                context.temperature = previous->temperature;
+                return context;
+            }
+
+            // linear interpolation
+            double f = static_cast<double>(time - previous->time) / (next->time - previous->time);
+            context.pressure = previous->pressure + f * (next->pressure - previous->pressure);
+            context.temperature = previous->temperature + f * (next->temperature - previous->temperature);
+
+            return context;
+        }
+
+    private:
+        struct Reading {
+            Long64_t time;
+            Double_t pressure;
+            Double_t temperature;
+            Long64_t data2Entry;
+        };
+
+        // recent readings
+        static constexpr size_t maxReadings = 64;
+        std::deque<Reading> readings;
+};
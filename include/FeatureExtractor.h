@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <algorithm>
+
+#include <TTree.h>
+#include <DigitizerData.h>
+#include <DigitizerConfig.h>
+
+// reduced data of a digitizer event
+struct DigitizerFeatures {
+
+    // per channel
+    std::array<Double_t,3> baseline = {0, 0, 0};    // mean of the first samples
+    std::array<Double_t,3> amplitude = {0, 0, 0};   // peak height above baseline
+    std::array<Double_t,3> charge = {0, 0, 0};      // integral above baseline
+    std::array<Int_t,3> peakPosition = {0, 0, 0};   // sample index of the peak
+};
+
+// extracts features from the waveforms of a digitizer event
+class FeatureExtractor {
+    public:
+
+        // constructor
+        FeatureExtractor(std::shared_ptr<DigitizerConfig> dc) : DC(dc) {}
+
+        // calculate features of every active channel
+        DigitizerFeatures extract(const DigitizerData& DData) {
+
+            DigitizerFeatures features;
+
+            const std::vector<UShort_t>* channels[3] = {&DData.ch0, &DData.ch1, &DData.ch2};
+
+            for (int channel = 0; channel <= 2; channel++) {
+
+                const std::vector<UShort_t>& samples = *channels[channel];
+                if (!DC->active[channel] || samples.empty()) continue;
+
+                // baseline from the pre-trigger region
+                size_t preTrigger = samples.size() * (100 - DC->postTriggerPct) / 100;
+                size_t nBaseline = std::clamp<size_t>(preTrigger / 2, 1, maxBaselineSamples);
+
+                Double_t baseline = 0;
+                for (size_t i = 0; i < nBaseline; i++) baseline += samples[i];
+                baseline /= nBaseline;
+
+                // pulses point down for falling polarity
+                Double_t sign = DC->polarityPositive[channel] ? 1.0 : -1.0;
+
+                // peak and charge
+                Double_t amplitude = 0;
+                Double_t charge = 0;
+                Int_t peakPosition = 0;
+
+                for (size_t i = 0; i < samples.size(); i++) {
+                    Double_t value = sign * (samples[i] - baseline);
+                    charge += value;
+                    if (value > amplitude) {
+                        amplitude = value;
+                        peakPosition = static_cast<Int_t>(i);
+                    }
+                }
+
+                features.baseline[channel] = baseline;
+                features.amplitude[channel] = amplitude;
+                features.charge[channel] = charge;
+                features.peakPosition[channel] = peakPosition;
+            }
+
+            return features;
+        }
+
+        // bitmask of the active channels that crossed their trigger threshold
+        unsigned firedChannels(const DigitizerFeatures& features, const std::array<uint16_t,3>& thresholds) {
+            unsigned mask = 0;
+            for (int channel = 0; channel <= 2; channel++) {
+                if (!DC->active[channel]) continue;
+
+                bool fired = DC->polarityPositive[channel]
+                    ? features.baseline[channel] + features.amplitude[channel] >= thresholds[channel]
+                    : features.baseline[channel] - features.amplitude[channel] <= thresholds[channel];
+
+                if (fired) mask |= 1u << channel;
+            }
+            return mask;
+        }
+
+    private:
+        // samples used for the baseline
+        static constexpr size_t maxBaselineSamples = 32;
+
+        // config
+        std::shared_ptr<DigitizerConfig> DC;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <TFile.h>
+#include <TTree.h>
+
+namespace fs = std::filesystem;
+
+// marker files of output files that are still written (<file>.open, lists the ROOT files)
+// and recovery of the files a crash left without header
+class FileRecovery {
+    public:
+
+        static fs::path markerPath(const fs::path& file) { return fs::path(file.string() + ".open"); }
+
+        // create marker with the ROOT files of an output file
+        static bool writeMarker(const fs::path& file, const std::vector<fs::path>& paths) {
+            std::ofstream marker(markerPath(file), std::ios::trunc);
+            for (const fs::path& path : paths) marker << path.string() << "\n";
+            marker.flush();
+            return marker.good();
+        }
+
+        static void removeMarker(const fs::path& file) {
+            std::error_code ec;
+            fs::remove(markerPath(file), ec);
+        }
+
+        // keep a marker that could not be recovered as <file>.failed (not tried again)
+        static fs::path markFailed(const fs::path& marker) {
+            fs::path failed = marker;
+            failed.replace_extension(".failed");
+            std::error_code ec;
+            fs::rename(marker, failed, ec);
+            return failed;
+        }
+
+        // markers left below dir
+        static std::vector<fs::path> findMarkers(const fs::path& dir) {
+            std::vector<fs::path> markers;
+            std::error_code ec;
+            for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+                if (it->is_regular_file() && it->path().extension() == ".open") markers.push_back(it->path());
+            }
+            return markers;
+        }
+
+        // ROOT files of a marker
+        static std::vector<fs::path> readMarker(const fs::path& marker) {
+            std::vector<fs::path> paths;
+            std::ifstream in(marker);
+            std::string line;
+            while (std::getline(in, line)) {
+                if (!line.empty()) paths.push_back(line);
+            }
+            return paths;
+        }
+
+        // open for update, ROOT rebuilds the key list of a file that was not closed
+        // (the trees contain the entries of their last AutoSave), closing writes a valid header
+        static bool recover(const fs::path& path, std::string& report) {
+
+            // check
+            std::error_code ec;
+            if (!fs::exists(path, ec)) {
+                report = path.filename().string() + ": missing";
+                return false;
+            }
+
+            TFile* file = TFile::Open(path.c_str(), "UPDATE");
+            if (!file || file->IsZombie()) {
+                report = path.filename().string() + ": cannot be opened";
+                delete file;
+                return false;
+            }
+
+            // entries of the trees after recovery
+            report = path.filename().string() + (file->TestBit(TFile::kRecovered) ? ": recovered" : ": closed properly");
+            for (const char* name : {"data1", "data2", "data3", "features", "degradation", "alarms"}) {
+                if (TTree* tree = file->Get<TTree>(name)) {
+                    report += std::string(", ") + name + " " + std::to_string(tree->GetEntries());
+                }
+            }
+
+            file->Close();
+            delete file;
+
+            return true;
+        }
+};
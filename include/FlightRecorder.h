@@ -0,0 +1,79 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <memory>
+
+#include <TTree.h>
+#include <DigitizerData.h>
+#include <TaskScheduler.h>
+
+class CollectorConfig;
+class ErrorHandler;
+
+// keeps the last seconds of full digitizer events in memory
+// and writes them to a separate file on request
+class FlightRecorder {
+    public:
+
+        // constructor and destructor
+        FlightRecorder(
+            std::shared_ptr<CollectorConfig> cc,
+            ErrorHandler *err,
+            TaskScheduler *ts
+        );
+        ~FlightRecorder();
+
+        // add event to ring buffer (reading thread)
+        void addEvent(const DigitizerData& DData);
+
+        // request a dump of the buffered window (any thread)
+        void requestDump(std::string const reason);
+
+        // start requested dump in background (reading thread)
+        bool checkDump();
+
+        // clear ring buffer
+        void clear();
+
+        // memory of the buffered events in bytes
+        size_t getMemory() { return bufferBytes; }
+
+        // wait till dump is finished
+        void joinDump();
+
+    private:
+
+        // write events to dump file
+        void writeDump(std::vector<DigitizerData> events, std::string reason);
+
+        // ring buffer
+        std::deque<DigitizerData> buffer;
+        size_t bufferBytes = 0;
+
+        // memory of one event
+        static size_t eventBytes(const DigitizerData& DData);
+
+        // dump request
+        std::atomic<bool> dumpRequested = false;
+        std::string dumpReason;
+        std::mutex mtx;
+
+        // dump task
+        TaskFuture dump;
+        std::atomic<bool> dumpRunning = false;
+        int dumpCount = 0;
+
+        // config
+        std::shared_ptr<CollectorConfig> CC;
+
+        // executor of the dump
+        TaskScheduler *TS;
+
+        // error handling
+        ErrorHandler *ERR;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+// memory of the large allocation sites compared with a total budget
+class MemoryAccountant {
+    public:
+
+        static constexpr size_t maxComponents = 16;
+
+        // register allocation site (before the threads start), returns its id
+        size_t registerComponent(const std::string& name) {
+            size_t id = numComponents < maxComponents ? numComponents++ : maxComponents - 1;
+            components[id].name = name;
+            return id;
+        }
+
+        // set current usage of a component in bytes
+        void set(size_t id, size_t bytes) {
+            components[id].bytes.store(bytes, std::memory_order_relaxed);
+        }
+
+        size_t get(size_t id) const {
+            return components[id].bytes.load(std::memory_order_relaxed);
+        }
+
+        // sum of all components
+        size_t getTotal() const {
+            size_t total = 0;
+            for (size_t i = 0; i < numComponents; i++) total += get(i);
+            return total;
+        }
+
+        // budget in bytes, 0 = unlimited
+        void setBudget(size_t bytes) { budget = bytes; }
+        size_t getBudget() const { return budget; }
+
+        // true if the total exceeds the fraction of the budget
+        bool exceeds(double fraction) const {
+            return budget > 0 && getTotal() > static_cast<size_t>(fraction * budget);
+        }
+
+        // usage per component in MB
+        std::string report() const {
+            auto toMB = [](size_t bytes) {
+                char buf[32];
+                std::snprintf(buf, sizeof(buf), "%.1f MB", bytes / 1048576.0);
+                return std::string(buf);
+            };
+
+            std::string text = "total " + toMB(getTotal());
+            if (budget > 0) text += " of " + toMB(budget);
+            for (size_t i = 0; i < numComponents; i++) {
+                text += ", " + components[i].name + " " + toMB(get(i));
+            }
+            return text;
+        }
+
+    private:
+        struct Component {
+            std::string name;
+            std::atomic<size_t> bytes = 0;
+        };
+
+        std::array<Component, maxComponents> components;
+        size_t numComponents = 0;
+        size_t budget = 0;
+};
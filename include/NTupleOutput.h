@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <TFile.h>
+#include <ROOT/RNTupleModel.hxx>
+#include <ROOT/RNTupleWriter.hxx>
+
+#include <DigitizerData.h>
+
+// writes data1, data2 and data3 as RNTuples into the current ROOT file
+// (same names and fields as the TTree branches, waveforms as vectors)
+// used by the RootTreeWriter and the conversion tool, so it reports errors as exceptions
+class NTupleOutput {
+    public:
+
+        // destructor
+        ~NTupleOutput();
+
+        // append the three RNTuples to the open file (throws on error)
+        void open(TFile* file, int compression);
+
+        // write remaining clusters (before the file is closed)
+        void close();
+
+        // write pages of all RNTuples to file
+        void commitCluster();
+
+        // add events, return the uncompressed bytes
+        Long64_t fillData1(const DigitizerData& DData);
+        Long64_t fillData2(Long64_t ts_data2_, Double_t rate_, Double_t pressure_);
+        Long64_t fillData3(Long64_t ts_data3_, const std::array<Double_t, 8>& tanca_);
+
+        // number of entries in data2
+        Long64_t getData2Entries() { return data2Entries; }
+
+    private:
+
+        // writers
+        std::unique_ptr<ROOT::RNTupleWriter> data1;
+        std::unique_ptr<ROOT::RNTupleWriter> data2;
+        std::unique_ptr<ROOT::RNTupleWriter> data3;
+
+        // field values of the models
+        std::shared_ptr<Long64_t> ts_data1;
+        std::shared_ptr<ULong64_t> eventID;
+        std::array<std::shared_ptr<std::vector<std::uint16_t>>, 3> waveform;
+
+        std::shared_ptr<Long64_t> ts_data2;
+        std::shared_ptr<Double_t> rate;
+        std::shared_ptr<Double_t> pressure;
+
+        std::shared_ptr<Long64_t> ts_data3;
+        std::array<std::shared_ptr<Double_t>, 8> tanca;
+
+        Long64_t data2Entries = 0;
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <TTree.h>
+
+// counters of the rate estimator
+enum RateCounter {
+    RateChannel0 = 0,
+    RateChannel1 = 1,
+    RateChannel2 = 2,
+    RateCoincidence = 3,    // at least two channels above threshold
+    RateEvents = 4,         // all digitizer events
+    NumRateCounters = 5
+};
+
+// rate of every counter in one window
+struct RateValue {
+    double window = 0;                                  // s
+    double liveTime = 0;                                // s covered by the window
+    std::array<double, NumRateCounters> rate{};         // Hz
+    std::array<double, NumRateCounters> error{};        // Hz (Poisson)
+};
+
+// Sliding window rates from the event time stamps.
+// Every window is a ring of time buckets, so adding an event and reading
+// a rate are O(1) and the memory does not depend on the rate.
+class RateEstimator {
+    public:
+
+        // window lengths in s, buckets per window
+        void configure(const std::vector<double>& windows_, int buckets_) {
+            buckets = static_cast<size_t>(std::max(buckets_, 2));
+            windows.clear();
+            for (double length : windows_) {
+                if (length <= 0) continue;
+                Window window;
+                window.length = length;
+                window.bucketWidth = std::max(static_cast<Long64_t>(length * 1e9 / buckets), Long64_t(1));
+                window.counts.assign(buckets, {});
+                windows.push_back(window);
+            }
+            reset();
+        }
+
+        // forget all events
+        void reset() {
+            started = false;
+            startTime = 0;
+            lastTime = 0;
+            for (Window& window : windows) {
+                for (auto& bucket : window.counts) bucket.fill(0);
+                window.sum.fill(0);
+                window.current = 0;
+            }
+        }
+
+        // add event with bitmask of the channels above threshold
+        void addEvent(Long64_t time, unsigned firedChannels) {
+            advance(time);
+
+            bool coincidence = ((firedChannels & 1) + ((firedChannels >> 1) & 1) + ((firedChannels >> 2) & 1)) >= 2;
+            for (Window& window : windows) {
+                auto& bucket = window.counts[window.current % buckets];
+                for (int channel = 0; channel <= 2; channel++) {
+                    if (firedChannels & (1u << channel)) { bucket[channel]++; window.sum[channel]++; }
+                }
+                if (coincidence) { bucket[RateCoincidence]++; window.sum[RateCoincidence]++; }
+                bucket[RateEvents]++;
+                window.sum[RateEvents]++;
+            }
+        }
+
+        // move all windows to time (older buckets are dropped)
+        void advance(Long64_t time) {
+
+            // first event starts the windows
+            if (!started) {
+                started = true;
+                startTime = time;
+                lastTime = time;
+                for (Window& window : windows) window.current = time / window.bucketWidth;
+                return;
+            }
+
+            // time stamps do not go back
+            if (time <= lastTime) return;
+            lastTime = time;
+
+            for (Window& window : windows) {
+                Long64_t index = time / window.bucketWidth;
+                Long64_t steps = std::min<Long64_t>(index - window.current, static_cast<Long64_t>(buckets));
+                for (Long64_t i = 1; i <= steps; i++) {
+                    auto& bucket = window.counts[(window.current + i) % buckets];
+                    for (size_t c = 0; c < NumRateCounters; c++) window.sum[c] -= bucket[c];
+                    bucket.fill(0);
+                }
+                window.current = index;
+            }
+        }
+
+        // rates of window i at the last event time (NaN before the first event)
+        RateValue getRate(size_t i) const {
+            RateValue value;
+            value.rate.fill(std::numeric_limits<double>::quiet_NaN());
+            value.error.fill(std::numeric_limits<double>::quiet_NaN());
+            if (i >= windows.size() || !started) return value;
+
+            const Window& window = windows[i];
+            value.window = window.length;
+
+            // covered time: full buckets plus the current one, not before the start
+            Long64_t windowStart = (window.current - static_cast<Long64_t>(buckets) + 1) * window.bucketWidth;
+            double liveTime = (lastTime - std::max(windowStart, startTime)) / 1e9;
+            value.liveTime = liveTime;
+
+            if (liveTime <= 0) return value;
+
+            for (size_t c = 0; c < NumRateCounters; c++) {
+                value.rate[c] = window.sum[c] / liveTime;
+                value.error[c] = std::sqrt(static_cast<double>(window.sum[c])) / liveTime;
+            }
+
+            return value;
+        }
+
+        // rates of all windows
+        std::vector<RateValue> getRates() const {
+            std::vector<RateValue> values;
+            for (size_t i = 0; i < windows.size(); i++) values.push_back(getRate(i));
+            return values;
+        }
+
+        size_t getWindowCount() const { return windows.size(); }
+
+        // time the windows started at (-1 before the first event)
+        Long64_t getStartTime() const { return started ? startTime : -1; }
+
+    private:
+        struct Window {
+            double length = 0;                                      // s
+            Long64_t bucketWidth = 1;                               // ns
+            Long64_t current = 0;                                   // index of the current bucket
+            std::vector<std::array<uint64_t, NumRateCounters>> counts;
+            std::array<uint64_t, NumRateCounters> sum{};
+        };
+
+        std::vector<Window> windows;
+        size_t buckets = 50;
+
+        bool started = false;
+        Long64_t startTime = 0;
+        Long64_t lastTime = 0;
+};
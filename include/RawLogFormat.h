@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// on-disk format of the raw event log
+// a segment starts with a RawSegmentHeader, followed by records aligned to 8 bytes
+// (little endian, the size of every record includes its header and padding)
+
+constexpr char rawLogMagic[8] = {'T', 'A', 'N', 'C', 'A', 'R', 'A', 'W'};
+constexpr uint32_t rawLogVersion = 1;
+
+// block size of the writes (O_DIRECT needs aligned sizes and addresses)
+constexpr size_t rawLogAlignment = 4096;
+
+enum RawRecordType : uint16_t {
+    RawPadding = 0,     // fill up to the block size, skipped by readers
+    RawDigitizer = 1,   // data1
+    RawArduino = 2,     // data2
+    RawTanca = 3        // data3
+};
+
+// flags of a record
+constexpr uint16_t rawFlagWaveformCodec = 1;   // samples encoded with the WaveformCodec
+
+struct RawSegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    int64_t created;        // ns since epoch
+    uint64_t sequence;      // number of the segment in the file period
+};
+
+struct RawRecordHeader {
+    uint32_t size;          // bytes of the record
+    uint16_t type;          // RawRecordType
+    uint16_t flags;
+    int64_t time;           // event time [ns]
+};
+
+// followed by nSamples[0] + nSamples[1] + nSamples[2] uint16_t samples
+// or by the three encoded channels (rawFlagWaveformCodec)
+struct RawDigitizerRecord {
+    uint64_t eventID;
+    uint32_t nSamples[3];
+    uint32_t reserved;
+};
+
+struct RawArduinoRecord {
+    double rate;
+    double pressure;
+};
+
+// h1, t1, h2, t2, h3, t3, h4, t4
+struct RawTancaRecord {
+    double tanca[8];
+};
+
+static_assert(sizeof(RawSegmentHeader) % 8 == 0, "segment header not aligned");
+static_assert(sizeof(RawRecordHeader) == 16, "record header has padding");
+static_assert(sizeof(RawDigitizerRecord) % 8 == 0, "digitizer record not aligned");
+
+// record size with header, rounded up to 8 bytes
+inline uint32_t rawRecordSize(size_t payload) {
+    return static_cast<uint32_t>((sizeof(RawRecordHeader) + payload + 7) & ~size_t(7));
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <RawLogFormat.h>
+#include <WaveformCodec.h>
+
+// reads one segment of the raw event log through a memory map
+// (no copies, records point directly into the mapped file)
+class RawLogReader {
+    public:
+
+        RawLogReader() = default;
+        RawLogReader(const RawLogReader&) = delete;
+        RawLogReader& operator=(const RawLogReader&) = delete;
+        ~RawLogReader() { close(); }
+
+        // map segment and check its header
+        bool open(const std::string& path) {
+            close();
+
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(RawSegmentHeader)) {
+                ::close(fd);
+                return false;
+            }
+
+            size = static_cast<size_t>(st.st_size);
+            void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (mapped == MAP_FAILED) {
+                size = 0;
+                return false;
+            }
+            data = static_cast<const char*>(mapped);
+            madvise(mapped, size, MADV_SEQUENTIAL);
+
+            // check
+            const RawSegmentHeader* header = getHeader();
+            if (std::memcmp(header->magic, rawLogMagic, sizeof(rawLogMagic)) != 0
+                || header->version != rawLogVersion
+                || header->headerSize < sizeof(RawSegmentHeader)
+                || header->headerSize > size) {
+                close();
+                return false;
+            }
+
+            offset = header->headerSize;
+            truncated = false;
+            return true;
+        }
+
+        void close() {
+            if (data) munmap(const_cast<char*>(data), size);
+            data = nullptr;
+            size = 0;
+            offset = 0;
+        }
+
+        const RawSegmentHeader* getHeader() const {
+            return reinterpret_cast<const RawSegmentHeader*>(data);
+        }
+
+        // next data record, nullptr at the end or at an incomplete record (see getTruncated)
+        const RawRecordHeader* next() {
+            while (data && offset + sizeof(RawRecordHeader) <= size) {
+                const RawRecordHeader* record = reinterpret_cast<const RawRecordHeader*>(data + offset);
+
+                // unwritten rest of a segment or a record cut by a crash
+                if (record->size < sizeof(RawRecordHeader) || record->size % 8 != 0 || offset + record->size > size) {
+                    truncated = record->size != 0;
+                    return nullptr;
+                }
+
+                offset += record->size;
+                if (record->type != RawPadding) return record;
+            }
+            return nullptr;
+        }
+
+        // reading stopped at a damaged record
+        bool getTruncated() const { return truncated; }
+
+        // payload of a record
+        template <typename T>
+        static const T* payload(const RawRecordHeader* record) {
+            return reinterpret_cast<const T*>(record + 1);
+        }
+
+        // samples of a digitizer record (ch0, ch1 and ch2 one after another, not encoded)
+        static const uint16_t* samples(const RawRecordHeader* record) {
+            return reinterpret_cast<const uint16_t*>(payload<RawDigitizerRecord>(record) + 1);
+        }
+
+        // waveforms of a digitizer record (plain or encoded), false if corrupt
+        static bool waveforms(const RawRecordHeader* record, std::vector<uint16_t> (&channels)[3]) {
+            const RawDigitizerRecord* digitizer = payload<RawDigitizerRecord>(record);
+            const uint8_t* data = reinterpret_cast<const uint8_t*>(digitizer + 1);
+            const uint8_t* end = reinterpret_cast<const uint8_t*>(record) + record->size;
+
+            for (int channel = 0; channel <= 2; channel++) {
+                size_t n = digitizer->nSamples[channel];
+
+                if (record->flags & rawFlagWaveformCodec) {
+                    if (!WaveformCodec::decode(data, end, channels[channel]) || channels[channel].size() != n) return false;
+                } else {
+                    if (static_cast<size_t>(end - data) < n * sizeof(uint16_t)) return false;
+                    channels[channel].resize(n);
+                    if (n) std::memcpy(channels[channel].data(), data, n * sizeof(uint16_t));
+                    data += n * sizeof(uint16_t);
+                }
+            }
+
+            return true;
+        }
+
+    private:
+        const char* data = nullptr;
+        size_t size = 0;
+        size_t offset = 0;
+        bool truncated = false;
+};
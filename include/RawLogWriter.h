@@ -0,0 +1,105 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <RtypesCore.h>
+#include <DigitizerData.h>
+#include <RawLogFormat.h>
+#include <WaveformCodec.h>
+#include <TaskScheduler.h>
+
+class CollectorConfig;
+class ErrorHandler;
+
+namespace fs = std::filesystem;
+
+// appends raw event records to segment files (<base>_000.raw, <base>_001.raw, ...)
+// records are copied into an aligned buffer, full buffers are written by a Writing task
+// while the next buffer is filled
+class RawLogWriter {
+    public:
+
+        // constructor and destructor
+        RawLogWriter(
+            std::shared_ptr<CollectorConfig> cc,
+            ErrorHandler *err,
+            TaskScheduler *ts
+        );
+        ~RawLogWriter();
+
+        // start first segment of a file period
+        bool open(const fs::path& basePath_);
+
+        // write buffered records and close the segment
+        bool close();
+
+        // add events, return the bytes of the record
+        size_t appendDigitizer(const DigitizerData& DData);
+        size_t appendArduino(Long64_t time, Double_t rate, Double_t pressure);
+        size_t appendTanca(Long64_t time, const std::array<Double_t, 8>& tanca);
+
+        // write the current buffer
+        void flush();
+
+        // segments of the current file period
+        std::vector<fs::path> getSegments() { return segments; }
+
+        // number of arduino records since open
+        Long64_t getArduinoRecords() { return arduinoRecords; }
+
+        // a write failed
+        bool getFailed() { return writeFailed.load(); }
+
+    private:
+
+        struct Buffer {
+            char* data = nullptr;
+            size_t used = 0;
+        };
+
+        // space for a record in the current buffer, nullptr if it is too large
+        char* reserve(size_t size);
+
+        // hand current buffer to a write task, switch to the other one
+        void submitBuffer();
+        void waitWrite();
+        void writeAll(int target, const char* data, size_t size);
+
+        // pad buffer to the block size (O_DIRECT)
+        void pad(Buffer& buffer);
+
+        // segment files
+        bool openSegment();
+        void closeSegment();
+
+        fs::path basePath;
+        std::vector<fs::path> segments;
+        int fd = -1;
+        size_t segmentBytes = 0;
+        Long64_t arduinoRecords = 0;
+
+        // double buffer
+        std::array<Buffer, 2> buffers;
+        size_t current = 0;
+        size_t capacity = 0;
+        TaskFuture pendingWrite;
+        std::atomic<bool> writeFailed = false;
+
+        // encoded waveforms of the current record
+        std::vector<uint8_t> encoded;
+
+        // config
+        std::shared_ptr<CollectorConfig> CC;
+
+        // executor of the writes
+        TaskScheduler *TS;
+
+        // error handling
+        ErrorHandler *ERR;
+};
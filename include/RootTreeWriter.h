@@ -3,41 +3,95 @@
 #include <string>
 #include <TFile.h>
 #include <TTree.h>
+#include <ROOT/TBufferMerger.hxx>
 #include <vector>
+#include <map>
+#include <memory>
 #include <atomic>
-#include <thread>
+#include <future>
+#include <mutex>
+#include <chrono>
 
 #include <ErrorHandler.h>
+#include <FeatureExtractor.h>
+#include <EnvironmentCache.h>
+#include <BurstDetector.h>
+#include <TaskScheduler.h>
+#include <DigitizerData.h>
+#include <NTupleOutput.h>
+#include <FileRecovery.h>
+#include <BackupEngine.h>
+#include <RawLogWriter.h>
+#include <TrackedFile.h>
 
 class CollectorConfig;
+class DigitizerConfig;
 
 namespace fs = std::filesystem;
 
 class RootTreeWriter {
     public:
     
-        // constructor
+        // constructor and destructor
         RootTreeWriter(
             std::shared_ptr<CollectorConfig> cc,
-            ErrorHandler *err
+            std::shared_ptr<DigitizerConfig> dc,
+            ErrorHandler *err,
+            TaskScheduler *ts
         );
+        ~RootTreeWriter();
+
+        // ROOT compression settings from algorithm and level
+        static int compressionSettings(const CollectorConfig& cc);
 
         // check fileOpen
-        bool getFileOpen() { if (file) return true; return false; }
+        bool getFileOpen() { if (current) return true; return false; }
+
+        // number of entries in data2 of the file of time
+        Long64_t getData2Entries(Long64_t time);
         
         // file handling
         bool openNewFile();
         bool closeCurrentFile();
 
+        // open the next file in the background (start in ns, used for the file name)
+        void prepareNextFile(Long64_t start);
+
+        // switch to the prepared file (opened now with start if not prepared),
+        // the old file is written and closed in the background
+        bool rotateFile(Long64_t start);
+
+        // bytes of the current file(s) on disk (baskets in memory not included)
+        Long64_t getFileBytes();
+
+        // output partitioned by event time (partitionByEventTime)
+        bool getPartitioned() { return partitionPeriod > 0; }
+
+        // start of the partition of time [ns] (lowest value if not partitioned)
+        Long64_t getPartitionStart(Long64_t time);
+
+        // open partitions up to the watermark (time all events before are processed),
+        // close those older than the grace period
+        bool advancePartitions(Long64_t watermark);
+
+        // bytes filled into baskets since the last flush (estimate of the basket memory)
+        size_t getUnflushedBytes() { return unflushedBytes + (current ? current->fillerBytes.load() : 0); }
+
+        // write baskets of all trees to file
+        void flushBaskets();
+
+        // write baskets and tree headers, a crashed file can be recovered up to here
+        void checkpoint();
+
         // add events
-        void set_data1(Long64_t ts_data1_, std::vector<Double_t>&& ch0_, std::vector<Double_t>&& ch1_, std::vector<Double_t>&& ch2_);
+        void set_data1(DigitizerData&& DData);
         void set_data2(Long64_t ts_data2_, Double_t rate_, Double_t pressure_);
         void set_data3(Long64_t ts_data3_, Double_t tanca_h2_, Double_t tanca_t1_, Double_t tanca_h1_, Double_t tanca_t2_, Double_t tanca_t3_, Double_t tanca_h3_, Double_t tanca_t4_, Double_t tanca_h4_);
+        void set_features(Long64_t ts_features_, ULong64_t eventID_, const DigitizerFeatures& features_, const EnvironmentContext& environment_);
+        void set_degradation(Long64_t ts_degradation_, Int_t level_, Long64_t queueDepth_, Double_t writerLag_);
+        void set_alarm(const BurstAlarm& alarm_);
 
-        // write backup
-        bool writeBackup();
-
-        // join backup thread
+        // copy all closed files to the backup now
         void joinBackup();
 
     private:
@@ -45,30 +99,169 @@ class RootTreeWriter {
         // file paths
         std::shared_ptr<CollectorConfig> CC;
 
-        // backup
-        std::thread backupThread;
-        std::atomic<bool> backupRunning = false;
+        // record length for the waveform buffers
+        std::shared_ptr<DigitizerConfig> DC;
+
+        // waveform branches of a data1 tree
+        struct WaveformBuffer {
+            Long64_t ts_data1;
+            ULong64_t eventID;
+            Int_t nSamples[3];
+            std::vector<UShort_t> waveform[3];
+        };
+
+        // parallel filling of data1 into one file (TBufferMerger mode)
+        struct Filler {
+            std::mutex mtx;
+            std::shared_ptr<ROOT::TBufferMergerFile> file;
+            TTree* data1 = nullptr;
+            WaveformBuffer buffer;
+            Long64_t unwrittenBytes = 0;
+            uint64_t checkpoint = 0;    // last checkpoint sent to the merger
+        };
+
+        // everything that belongs to the file of one period
+        struct OutputFile {
+            Long64_t start = 0;     // ns
+            std::string folderName;
+            std::string fileName;
+            std::filesystem::path filePath;
+
+            // data handling
+            TFile* file = nullptr;
+
+            // waveforms (same as file unless split)
+            bool splitFile = false;
+            std::filesystem::path waveformPath;
+            TFile* waveformFile = nullptr;
+
+            // ranges ROOT wrote again, read by the backup at the close (with enableBackup)
+            std::shared_ptr<RewriteLog> rewrites;
+            std::shared_ptr<RewriteLog> waveformRewrites;
+
+            // data1, data2 and data3 as RNTuples (instead of the trees)
+            std::unique_ptr<NTupleOutput> ntuples;
+
+            // data1, data2 and data3 as raw log segments next to the file
+            std::unique_ptr<RawLogWriter> rawLog;
+            std::vector<fs::path> rawSegments;
+
+            // trees
+            TTree* data1 = nullptr;
+            TTree* data2 = nullptr;
+            TTree* data3 = nullptr;
+            TTree* features = nullptr;
+            TTree* degradation = nullptr;
+            TTree* alarms = nullptr;
+
+            // branch placeholder of data1 (resized per file)
+            WaveformBuffer data1Buffer;
+
+            // TBufferMerger mode
+            std::unique_ptr<ROOT::TBufferMerger> merger;
+            std::shared_ptr<ROOT::TBufferMergerFile> mergerFile;   // holds all other trees
+            std::vector<std::unique_ptr<Filler>> fillers;
+            std::atomic<size_t> nextFiller = 0;
+            std::vector<DigitizerData> batch;
+            std::vector<TaskFuture> fillerTasks;
+            std::atomic<size_t> fillerBytes = 0;
+            std::atomic<uint64_t> checkpoints = 0;
+
+            // events of another time slot (partition already closed)
+            Long64_t misplacedEvents = 0;
 
-        std::string folderName;
-        std::string fileName;
-        std::filesystem::path filePath;
+            // size on disk
+            Long64_t fileBytes = 0;
+            std::chrono::steady_clock::time_point sizeTime;
 
-        void copyFile(fs::path source, fs::path dest);
+            // statistics
+            std::chrono::steady_clock::time_point openTime;
+            std::atomic<Long64_t> filledBytes = 0;
+            std::atomic<Long64_t> writeNanoseconds = 0;
+        };
 
-        // data handling
-        TFile* file = nullptr;
+        // open file starting at time (ns), nullptr on error
+        std::shared_ptr<OutputFile> createFile(Long64_t time);
 
-        // trees
-        TTree* data1 = nullptr;
-        TTree* data2 = nullptr;
-        TTree* data3 = nullptr;
+        // next free sequence number of the files in the folder
+        static int nextSequence(const fs::path& folder);
 
-        // branch placeholder variables
-        Long64_t ts_data1;
-        std::vector<Double_t> ch0;
-        std::vector<Double_t> ch1;
-        std::vector<Double_t> ch2;
+        // write all trees and close the file(s)
+        bool closeFile(OutputFile& out);
 
+        // close, report and start the backup
+        bool finalizeFile(OutputFile& out);
+
+        // close a prepared file that was never used and remove it
+        void discardFile(OutputFile& out);
+
+        // recover files of a crashed run (markers in the working directory) and back them up
+        void recoverFiles();
+        bool recoveryStarted = false;
+
+        // current, prepared and closing files
+        std::shared_ptr<OutputFile> current;
+        std::shared_ptr<OutputFile> next;
+        Long64_t nextStart = 0;
+        TaskFuture preparing;
+        std::mutex nextMtx;
+        void discardPrepared();
+        std::vector<TaskFuture> finalizing;
+        void joinFinalize();
+
+        // open partitions by slot start, the newest is the current file
+        std::map<Long64_t, std::shared_ptr<OutputFile>> partitions;
+        Long64_t partitionPeriod = 0;
+        Long64_t slotOf(Long64_t time) const;
+        std::shared_ptr<OutputFile> openPartition(Long64_t slot);
+
+        // file of an event (current file if not partitioned)
+        OutputFile& fileFor(Long64_t time);
+
+        // parallel basket compression (set before files are created)
+        void configureImplicitMT();
+
+        // backup copies (streamed while the files are written)
+        BackupEngine BE;
+
+        // write backup
+        bool writeBackup(const OutputFile& out);
+
+        // index data1 by event ID and add it as friend of features
+        bool linkWaveforms(OutputFile& out);
+
+        // fill tree, count bytes and time
+        Int_t fill(OutputFile& out, TTree* tree);
+
+        // count bytes and time of a fill
+        template <typename F>
+        Long64_t measure(OutputFile& out, F&& fillFunction) {
+
+            // time in ROOT (compression of full baskets)
+            auto start = std::chrono::steady_clock::now();
+            Long64_t bytes = fillFunction();
+            out.writeNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            out.filledBytes += bytes;
+
+            return bytes;
+        }
+
+        // basket size and flush interval
+        void configureTree(TTree* tree);
+
+        TTree* createWaveformTree(WaveformBuffer& buffer, TDirectory* dir);
+        void setWaveform(TTree* tree, WaveformBuffer& buffer, const DigitizerData& DData);
+
+        void dispatchBatch(OutputFile& out);
+        void fillBatch(OutputFile& out, const std::vector<DigitizerData>& events);
+        void fillWith(OutputFile& out, Filler& filler, const std::vector<DigitizerData>& events);
+        void sendFiller(OutputFile& out, Filler& filler);      // memory file to the merger (filler locked)
+        void closeFillers(OutputFile& out);
+
+        // write speed and compression of a closed file
+        void reportStatistics(const OutputFile& out);
+
+        // branch placeholder variables (shared by the trees of all files, filled one at a time)
         Long64_t ts_data2;
         Double_t rate;
         Double_t pressure;
@@ -83,6 +276,24 @@ class RootTreeWriter {
         Double_t tanca_h4;
         Double_t tanca_t4;
 
+        Long64_t ts_features;
+        ULong64_t featureEventID;
+        DigitizerFeatures featureValues;
+        EnvironmentContext environment;
+
+        Long64_t ts_degradation;
+        Int_t level;
+        Long64_t queueDepth;
+        Double_t writerLag;
+
+        BurstAlarm alarm;
+
+        // memory of the baskets of the current file
+        size_t unflushedBytes = 0;
+
+        // executor of preparation, finalization, fillers and backup
+        TaskScheduler *TS;
+
         // error handling
         ErrorHandler *ERR;
 };
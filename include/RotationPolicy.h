@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <TTree.h>
+#include <CollectorConfig.h>
+
+// size of the current output file
+struct RotationState {
+    Long64_t bytes = 0;     // on disk
+    Long64_t events = 0;    // digitizer events
+};
+
+// decides when the current output file is closed and the next one is started
+class RotationPolicy {
+    public:
+        virtual ~RotationPolicy() = default;
+
+        // new file started at now [ns]
+        virtual void reset(Long64_t now) = 0;
+
+        // current file is complete
+        virtual bool due(const RotationState& state, Long64_t now) const = 0;
+
+        // rotation is close, time to prepare the next file (lead in ns)
+        virtual bool soon(const RotationState& state, Long64_t now, Long64_t lead) const = 0;
+
+        // time of the next rotation [ns], -1 if not time based
+        virtual Long64_t getBoundary() const { return -1; }
+};
+
+// fixed duration, boundaries at multiples of the period since the epoch
+// (full hours, days, ... in UTC for periods that divide a day)
+class TimeRotation : public RotationPolicy {
+    public:
+        explicit TimeRotation(Long64_t period_) : period(std::max<Long64_t>(period_, 1)) {}
+
+        void reset(Long64_t now) override { boundary = (now / period + 1) * period; }
+        bool due(const RotationState&, Long64_t now) const override { return now >= boundary; }
+        bool soon(const RotationState&, Long64_t now, Long64_t lead) const override { return now >= boundary - lead; }
+        Long64_t getBoundary() const override { return boundary; }
+
+    private:
+        Long64_t period;
+        Long64_t boundary = 0;
+};
+
+// maximum size on disk
+class SizeRotation : public RotationPolicy {
+    public:
+        explicit SizeRotation(Long64_t maxBytes_) : maxBytes(maxBytes_) {}
+
+        void reset(Long64_t) override {}
+        bool due(const RotationState& state, Long64_t) const override { return state.bytes >= maxBytes; }
+        bool soon(const RotationState& state, Long64_t, Long64_t) const override { return state.bytes >= maxBytes - maxBytes / 10; }
+
+    private:
+        Long64_t maxBytes;
+};
+
+// maximum number of digitizer events
+class EventRotation : public RotationPolicy {
+    public:
+        explicit EventRotation(Long64_t maxEvents_) : maxEvents(maxEvents_) {}
+
+        void reset(Long64_t) override {}
+        bool due(const RotationState& state, Long64_t) const override { return state.events >= maxEvents; }
+        bool soon(const RotationState& state, Long64_t, Long64_t) const override { return state.events >= maxEvents - maxEvents / 10; }
+
+    private:
+        Long64_t maxEvents;
+};
+
+// first of several policies (none = one file per run)
+class CombinedRotation : public RotationPolicy {
+    public:
+        void add(std::unique_ptr<RotationPolicy> policy) { policies.push_back(std::move(policy)); }
+
+        void reset(Long64_t now) override {
+            for (auto& policy : policies) policy->reset(now);
+        }
+
+        bool due(const RotationState& state, Long64_t now) const override {
+            return std::any_of(policies.begin(), policies.end(), [&](const auto& policy) { return policy->due(state, now); });
+        }
+
+        bool soon(const RotationState& state, Long64_t now, Long64_t lead) const override {
+            return std::any_of(policies.begin(), policies.end(), [&](const auto& policy) { return policy->soon(state, now, lead); });
+        }
+
+        Long64_t getBoundary() const override {
+            Long64_t boundary = -1;
+            for (const auto& policy : policies) {
+                Long64_t b = policy->getBoundary();
+                if (b >= 0 && (boundary < 0 || b < boundary)) boundary = b;
+            }
+            return boundary;
+        }
+
+        // policies from the config
+        static std::unique_ptr<CombinedRotation> fromConfig(const CollectorConfig& cc) {
+            auto combined = std::make_unique<CombinedRotation>();
+            if (cc.rotationPeriod > 0) combined->add(std::make_unique<TimeRotation>(static_cast<Long64_t>(cc.rotationPeriod * 1e9)));
+            if (cc.rotationMaxMB > 0) combined->add(std::make_unique<SizeRotation>(static_cast<Long64_t>(cc.rotationMaxMB * 1e6)));
+            if (cc.rotationMaxEvents > 0) combined->add(std::make_unique<EventRotation>(cc.rotationMaxEvents));
+            return combined;
+        }
+
+    private:
+        std::vector<std::unique_ptr<RotationPolicy>> policies;
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <optional>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+#include <DataNotifier.h>
+
+// behaviour of push if the queue is full
+enum class QueueFullPolicy {
+    Block,          // wait till the consumer made room
+    DropNewest,     // discard the new element
+    DropOldest      // discard the oldest element in the queue
+};
+
+// Bounded lock-free queue for one producer and one consumer.
+// Every slot carries a sequence number, so the producer can also remove
+// the oldest element (DropOldest) without racing against the consumer.
+template <typename T>
+class SPSCQueue {
+private:
+    static constexpr size_t cacheLine = 64;
+
+    // preallocated storage for one element
+    struct Slot {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    // slots
+    std::unique_ptr<Slot[]> m_slots;
+    size_t m_capacity = 0;
+    size_t m_mask = 0;
+
+    QueueFullPolicy m_policy = QueueFullPolicy::Block;
+
+    // indices on their own cache lines
+    alignas(cacheLine) std::atomic<size_t> m_head = 0;     // next slot to write (producer)
+    alignas(cacheLine) std::atomic<size_t> m_tail = 0;     // next slot to read (consumer)
+
+    // statistics (written by the producer)
+    alignas(cacheLine) std::atomic<size_t> m_highWaterMark = 0;
+    std::atomic<uint64_t> m_dropped = 0;
+
+    // blocked producers give up if the queue is closed
+    std::atomic<bool> m_closed = false;
+
+    // consumer to wake after a push
+    DataNotifier* m_notifier = nullptr;
+
+    // write element into a free slot
+    bool tryPush(T& item) {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[pos & m_mask];
+
+        // slot not yet released by the consumer
+        if (slot.sequence.load(std::memory_order_acquire) != pos) return false;
+
+        new (&slot.storage) T(std::move(item));
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        m_head.store(pos + 1, std::memory_order_release);
+
+        // update high-water mark
+        size_t used = pos + 1 - m_tail.load(std::memory_order_relaxed);
+        if (used > m_highWaterMark.load(std::memory_order_relaxed)) {
+            m_highWaterMark.store(used, std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+public:
+    // constructor and destructor
+    explicit SPSCQueue(size_t capacity = 1024, QueueFullPolicy policy = QueueFullPolicy::Block) {
+        configure(capacity, policy);
+    }
+
+    ~SPSCQueue() {
+        clear();
+    }
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    // set capacity (rounded up to a power of two) and policy,
+    // only while no producer or consumer is running
+    void configure(size_t capacity, QueueFullPolicy policy) {
+        clear();
+
+        size_t rounded = 2;
+        while (rounded < capacity) rounded <<= 1;
+
+        if (rounded != m_capacity) {
+            m_slots.reset(new Slot[rounded]);
+            m_capacity = rounded;
+            m_mask = rounded - 1;
+        }
+
+        for (size_t i = 0; i < m_capacity; i++) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        m_head.store(0);
+        m_tail.store(0);
+        m_policy = policy;
+        resetStatistics();
+    }
+
+    // Pushes an element to the queue, returns false if it was dropped
+    bool push(T item) {
+        while (!tryPush(item)) {
+
+            switch (m_policy) {
+                case QueueFullPolicy::DropNewest:
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+
+                case QueueFullPolicy::DropOldest:
+                    if (pop()) m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    else std::this_thread::yield();
+                    break;
+
+                case QueueFullPolicy::Block:
+                    if (m_closed.load(std::memory_order_relaxed)) {
+                        m_dropped.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    break;
+            }
+        }
+
+        // wake consumer
+        if (m_notifier) m_notifier->notify();
+
+        return true;
+    }
+
+    // push several elements, returns the number of elements not dropped
+    size_t pushBatch(std::vector<T>& items) {
+        size_t pushed = 0;
+        for (T& item : items) {
+            if (push(std::move(item))) pushed++;
+        }
+        items.clear();
+        return pushed;
+    }
+
+    // remove element from the queue
+    std::optional<T> pop() {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+
+        for (;;) {
+            Slot& slot = m_slots[pos & m_mask];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+
+            // return nullopt, if queue is empty
+            if (diff < 0) return std::nullopt;
+
+            // slot was taken by the other side, retry with the current tail
+            if (diff > 0) {
+                pos = m_tail.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            // claim slot (fails if the producer dropped it meanwhile)
+            if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                T* ptr = std::launder(reinterpret_cast<T*>(&slot.storage));
+                std::optional<T> item(std::move(*ptr));
+                ptr->~T();
+
+                // release slot for the next round
+                slot.sequence.store(pos + m_capacity, std::memory_order_release);
+
+                return item;
+            }
+        }
+    }
+
+    // remove up to maxItems elements, returns the number of elements
+    size_t popBatch(std::vector<T>& items, size_t maxItems) {
+        size_t popped = 0;
+        while (popped < maxItems) {
+            std::optional<T> item = pop();
+            if (!item) break;
+            items.push_back(std::move(*item));
+            popped++;
+        }
+        return popped;
+    }
+
+    // remove all elements
+    void clear() {
+        if (!m_slots) return;
+        while (pop()) {}
+    }
+
+    // consumer is notified after every push (set before the producer starts)
+    void setNotifier(DataNotifier* notifier) { m_notifier = notifier; }
+
+    // blocked producers return while the queue is closed
+    void close() { m_closed.store(true); }
+    void reopen() { m_closed.store(false); }
+
+    // number of elements in the queue
+    size_t size() const {
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        size_t head = m_head.load(std::memory_order_acquire);
+        return head >= tail ? head - tail : 0;
+    }
+
+    // statistics
+    size_t getCapacity() const { return m_capacity; }
+    size_t getHighWaterMark() const { return m_highWaterMark.load(std::memory_order_relaxed); }
+    uint64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    void resetStatistics() {
+        m_highWaterMark.store(0);
+        m_dropped.store(0);
+    }
+};
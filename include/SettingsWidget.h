@@ -54,6 +54,10 @@ class Settings : public QFrame {
 
         QCheckBox *enableAcquisitionLimitCB;
         QSpinBox *acquisitionLimitSB;
+        QComboBox *acquisitionLimitModeCB;
+
+        QCheckBox *enableFlightRecorderCB;
+        QSpinBox *flightRecorderSecondsSB;
 
         QLabel *recordLengthL;
         QComboBox *recordLengthCB;
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <algorithm>
+
+#include <CalibrationDevice.h>
+#include <DigitizerConfig.h>
+
+// simple model of the digitizer channels to run the calibration without hardware
+class SimulatedDigitizer : public CalibrationDevice {
+    public:
+
+        // constructor
+        SimulatedDigitizer(std::shared_ptr<DigitizerConfig> dc)
+          : DC(dc),
+            dcOffset(dc->dcOffset),
+            threshold(dc->triggerThreshold),
+            generator(std::random_device{}())
+        {}
+
+        bool setChannelDCOffset(int channel, uint16_t dcOffset_) override {
+            dcOffset[channel] = dcOffset_;
+            return true;
+        }
+
+        bool setChannelTriggerThreshold(int channel, uint16_t threshold_) override {
+            threshold[channel] = threshold_;
+            return true;
+        }
+
+        bool measureBaseline(int channel, int nTriggers, double& mean, double& rms) override {
+
+            // baseline follows the DC offset, clipped by the ADC range
+            std::normal_distribution<double> noise(baseline(channel), noiseRMS);
+
+            double sum = 0, sum2 = 0;
+            size_t n = static_cast<size_t>(std::max(nTriggers, 1)) * DC->recordLength;
+
+            for (size_t i = 0; i < n; i++) {
+                double sample = std::clamp(std::round(noise(generator)), 0.0, 4095.0);
+                sum += sample;
+                sum2 += sample * sample;
+            }
+
+            mean = sum / n;
+            rms = std::sqrt(std::max(sum2 / n - mean * mean, 0.0));
+            return true;
+        }
+
+        bool countTriggers(int channel, double seconds, uint64_t& triggers, double& liveTime) override {
+
+            // distance of the threshold from the baseline in pulse direction
+            double sign = DC->polarityPositive[channel] ? 1.0 : -1.0;
+            double distance = sign * (threshold[channel] - baseline(channel));
+
+            // threshold on the wrong side triggers continuously
+            double rate = maxRate;
+            if (distance > 0) {
+                double noiseRate = maxRate * std::exp(-distance * distance / (2 * noiseRMS * noiseRMS));
+                double muonRate = muonRateAtBaseline * std::exp(-distance / muonScale);
+                rate = std::min(noiseRate + muonRate, maxRate);
+            }
+
+            // no waiting, the expected counts are drawn directly
+            std::poisson_distribution<uint64_t> counts(rate * seconds);
+            triggers = counts(generator);
+            liveTime = seconds;
+            return true;
+        }
+
+    private:
+        // baseline of the channel in ADC counts
+        double baseline(int channel) const {
+            return std::clamp(channelOffset[channel] + 4095.0 * dcOffset[channel] / 65535.0, 0.0, 4095.0);
+        }
+
+        // model parameters
+        static constexpr double noiseRMS = 2.5;                 // ADC counts
+        static constexpr double maxRate = 1.0e5;                // Hz, readout limit
+        static constexpr double muonRateAtBaseline = 200;       // Hz
+        static constexpr double muonScale = 150;                // ADC counts
+        std::array<double,3> channelOffset = {-35, 12, 27};     // ADC counts
+
+        // config
+        std::shared_ptr<DigitizerConfig> DC;
+
+        // settings
+        std::array<uint16_t,3> dcOffset;
+        std::array<uint16_t,3> threshold;
+
+        std::mt19937 generator;
+};
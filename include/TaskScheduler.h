@@ -0,0 +1,183 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CollectorConfig;
+class ErrorHandler;
+
+// priority classes, lower value runs first
+enum class TaskPriority {
+    Readout = 0,    // digitizer readout
+    Processing = 1, // consume queues, fill trees
+    Writing = 2,    // flight recorder dumps
+    Backup = 3      // copy files to backup
+};
+
+// handle of a timer, 0 = no timer
+using TimerID = uint64_t;
+
+// result of a submitted task
+// waiting runs the task in the calling thread if no worker has started it yet,
+// so a task can wait for its subtasks even if all other workers are blocked
+class TaskFuture {
+    public:
+
+        TaskFuture() = default;
+
+        bool valid() const { return future.valid(); }
+
+        // finished (or nothing submitted)
+        bool ready() const {
+            return !future.valid() || future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+
+        void wait() {
+            if (!future.valid()) return;
+            if (task) task->run();
+            future.wait();
+        }
+
+    private:
+        friend class TaskScheduler;
+
+        // runs once, by a worker or by the waiting thread
+        struct Task {
+            std::atomic<bool> started = false;
+            std::packaged_task<void()> function;
+
+            void run() {
+                if (!started.exchange(true)) function();
+            }
+        };
+
+        std::shared_ptr<Task> task;
+        std::future<void> future;
+};
+
+// Executor shared by all pipeline stages.
+// Every worker owns one deque per priority class: it takes its own tasks from
+// the back and steals from the front of the other workers, so idle cores
+// absorb bursts. A timer wheel submits delayed and periodic tasks.
+class TaskScheduler {
+    public:
+
+        // constructor and destructor
+        TaskScheduler(
+            std::shared_ptr<CollectorConfig> cc,
+            ErrorHandler *err
+        );
+        ~TaskScheduler();
+
+        TaskScheduler(const TaskScheduler&) = delete;
+        TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+        // start workers and timer wheel
+        bool start();
+
+        // run remaining tasks, then stop all threads
+        void stop();
+
+        bool getRunning() { return isRunning.load(); }
+
+        // run task as soon as a worker is free (or when it is waited for)
+        TaskFuture submit(TaskPriority priority, std::function<void()> task);
+
+        // run task after delay, repeated every period if period > 0
+        // a periodic task is skipped while its previous run is queued or running
+        TimerID schedule(
+            TaskPriority priority,
+            std::chrono::nanoseconds delay,
+            std::chrono::nanoseconds period,
+            std::function<void()> task
+        );
+
+        // remove timer and wait till a running instance is finished
+        void cancel(TimerID id);
+
+        // number of workers
+        size_t getWorkerCount() { return workers.size(); }
+
+    private:
+
+        static constexpr size_t numPriorities = 4;
+        static constexpr size_t wheelSlots = 256;
+        static constexpr std::chrono::milliseconds tick{10};
+
+        using Task = std::function<void()>;
+
+        // task deques of one worker
+        struct Worker {
+            std::mutex mtx;
+            std::array<std::deque<Task>, numPriorities> tasks;
+            std::thread thread;
+        };
+
+        // entry of the timer wheel
+        struct Timer {
+            TimerID id;
+            TaskPriority priority;
+            uint64_t periodTicks;
+            uint64_t rounds;
+            Task task;
+
+            std::atomic<bool> cancelled = false;
+            std::atomic<bool> inFlight = false;
+
+            // held while the task runs
+            std::mutex runMtx;
+            std::atomic<std::thread::id> runner;
+        };
+
+        // worker threads
+        void workerLoop(size_t index);
+        bool findTask(size_t index, Task& task);
+        void push(TaskPriority priority, Task task);
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<size_t> nextWorker = 0;
+
+        // sleeping workers
+        std::atomic<size_t> queued = 0;
+        std::mutex sleepMtx;
+        std::condition_variable sleepCond;
+
+        // timer wheel
+        void timerLoop();
+        void insertTimer(const std::shared_ptr<Timer>& timer, uint64_t ticks);
+        void fireTimer(const std::shared_ptr<Timer>& timer);
+
+        std::array<std::list<std::shared_ptr<Timer>>, wheelSlots> wheel;
+        std::unordered_map<TimerID, std::shared_ptr<Timer>> timers;
+        uint64_t currentTick = 0;
+        TimerID nextTimerID = 1;
+        std::mutex timerMtx;
+        std::condition_variable timerCond;
+        std::thread timerThread;
+
+        // status
+        std::atomic<bool> isRunning = false;
+        std::atomic<bool> isStopping = false;
+
+        // worker of the current thread
+        static thread_local TaskScheduler* currentScheduler;
+        static thread_local size_t currentWorker;
+
+        // config
+        std::shared_ptr<CollectorConfig> CC;
+
+        // error handling
+        ErrorHandler *ERR;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+
+#include <TTree.h>
+#include <DigitizerConfig.h>
+#include <FeatureExtractor.h>
+
+// adjusts the trigger thresholds to hold a target trigger rate per channel
+class ThresholdController {
+    public:
+
+        // set target rate [Hz], bounds and control interval [ns]
+        void configure(double targetRate_, double tolerance_, uint16_t minThreshold_, uint16_t maxThreshold_, uint16_t step_, Long64_t interval_) {
+            targetRate = targetRate_;
+            tolerance = tolerance_;
+            minThreshold = std::min(minThreshold_, maxThreshold_);
+            maxThreshold = std::max(minThreshold_, maxThreshold_);
+            step = std::max<uint16_t>(step_, 1);
+            interval = std::max<Long64_t>(interval_, 1);
+        }
+
+        // start new interval with the current settings and the applied thresholds
+        void reset(const DigitizerConfig& dc, const std::array<uint16_t,3>& thresholds_, Long64_t now) {
+            thresholds = thresholds_;
+            polarityPositive = dc.polarityPositive;
+            active = dc.active;
+            counts = {0, 0, 0};
+            intervalStart = now;
+        }
+
+        // count channels that crossed their threshold
+        void addEvent(const DigitizerFeatures& features) {
+            for (int channel = 0; channel <= 2; channel++) {
+                if (!active[channel]) continue;
+
+                bool fired = polarityPositive[channel]
+                    ? features.baseline[channel] + features.amplitude[channel] >= thresholds[channel]
+                    : features.baseline[channel] - features.amplitude[channel] <= thresholds[channel];
+
+                if (fired) counts[channel]++;
+            }
+        }
+
+        // calculate new thresholds at the end of an interval, returns true if one changed
+        bool update(Long64_t now, std::array<uint16_t,3>& newThresholds) {
+
+            // interval not finished
+            if (now - intervalStart < interval) return false;
+
+            double seconds = (now - intervalStart) / 1e9;
+            bool changed = false;
+
+            for (int channel = 0; channel <= 2; channel++) {
+                if (!active[channel]) continue;
+
+                double rate = counts[channel] / seconds;
+                rates[channel] = rate;
+
+                // moving away from the baseline lowers the rate
+                int away = polarityPositive[channel] ? step : -step;
+                int threshold = thresholds[channel];
+
+                if (rate > targetRate * (1 + tolerance)) threshold += away;
+                else if (rate < targetRate * (1 - tolerance)) threshold -= away;
+
+                threshold = std::clamp<int>(threshold, minThreshold, maxThreshold);
+
+                if (threshold != thresholds[channel]) {
+                    thresholds[channel] = static_cast<uint16_t>(threshold);
+                    changed = true;
+                }
+            }
+
+            // start next interval
+            counts = {0, 0, 0};
+            intervalStart = now;
+
+            newThresholds = thresholds;
+            return changed;
+        }
+
+        // rates of the last interval [Hz]
+        const std::array<double,3>& getRates() const { return rates; }
+
+    private:
+        // target
+        double targetRate = 50;
+        double tolerance = 0.2;
+
+        // bounds
+        uint16_t minThreshold = 0;
+        uint16_t maxThreshold = 4095;
+        uint16_t step = 10;
+
+        // interval
+        Long64_t interval = 10000000000LL;
+        Long64_t intervalStart = 0;
+
+        // state per channel
+        std::array<uint16_t,3> thresholds = {0, 0, 0};
+        std::array<bool,3> polarityPositive = {false, false, false};
+        std::array<bool,3> active = {false, false, false};
+        std::array<uint64_t,3> counts = {0, 0, 0};
+        std::array<double,3> rates = {0, 0, 0};
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <TFile.h>
+
+// byte ranges [begin, end) of a file that its writer wrote again (filled by the writer, read by the backup)
+class RewriteLog {
+    public:
+
+        void add(Long64_t offset, Long64_t length) {
+            std::lock_guard<std::mutex> lock(mtx);
+
+            // consecutive writes extend the last range
+            if (!ranges.empty() && offset >= ranges.back().first && offset <= ranges.back().second) {
+                ranges.back().second = std::max(ranges.back().second, offset + length);
+                return;
+            }
+            ranges.emplace_back(offset, offset + length);
+        }
+
+        std::vector<std::pair<Long64_t, Long64_t>> get() {
+            std::lock_guard<std::mutex> lock(mtx);
+            return ranges;
+        }
+
+    private:
+        std::vector<std::pair<Long64_t, Long64_t>> ranges;
+        std::mutex mtx;
+};
+
+// TFile that logs its writes into the part of the file written before (ROOT rewrites the header,
+// key lists and tree metadata and reuses freed space for new keys), so a copy streamed while the
+// file is written only reads these ranges again when it is closed
+// writes of the TFile constructor are not seen (first record only, rewritten at the close anyway)
+class TrackedFile : public TFile {
+    public:
+
+        TrackedFile(const char* name, Option_t* option, const char* title, Int_t compress, std::shared_ptr<RewriteLog> log)
+          : TFile(name, option, title, compress),
+            rewrites(std::move(log))
+        {
+            if (IsZombie()) return;
+            end = GetEND();
+            position = TFile::SysSeek(GetFd(), 0, SEEK_CUR);
+        }
+
+    protected:
+
+        Long64_t SysSeek(Int_t fd, Long64_t offset, Int_t whence) override {
+            position = TFile::SysSeek(fd, offset, whence);
+            return position;
+        }
+
+        Int_t SysWrite(Int_t fd, const void* buf, Int_t len) override {
+            Int_t n = TFile::SysWrite(fd, buf, len);
+            if (n > 0 && position >= 0) {
+                if (rewrites && position < end) rewrites->add(position, n);
+                position += n;
+                end = std::max(end, position);
+            }
+            return n;
+        }
+
+    private:
+        std::shared_ptr<RewriteLog> rewrites;
+
+        // end of the data written so far and current offset (-1 if unknown)
+        Long64_t end = 0;
+        Long64_t position = -1;
+};
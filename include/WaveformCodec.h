@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// lossless codec for digitizer waveforms
+// every block of 32 samples is predicted either from the previous sample (pulses)
+// or from the block minimum (noise on a flat baseline), whichever needs fewer bits;
+// the residuals are bit-packed with the width of the largest one
+//
+// channel: varint count, first sample (2 bytes), per block:
+//   delta mode: width (1 byte), 4 * width bytes of zigzag deltas
+//   baseline mode: width | 0x80 (1 byte), minimum (2 bytes), 4 * width bytes
+class WaveformCodec {
+    public:
+
+        static constexpr size_t blockSize = 32;
+
+        // append encoded samples to out
+        static void encode(const uint16_t* samples, size_t count, std::vector<uint8_t>& out) {
+            putVarint(out, count);
+            if (count == 0) return;
+
+            out.push_back(static_cast<uint8_t>(samples[0]));
+            out.push_back(static_cast<uint8_t>(samples[0] >> 8));
+
+            uint32_t deltas[blockSize];
+            uint32_t offsets[blockSize];
+            for (size_t start = 1; start < count; start += blockSize) {
+                size_t n = std::min(blockSize, count - start);
+
+                // block with the last sample repeated (fixed length loops, vectorized by the compiler)
+                uint16_t block[blockSize + 1];
+                for (size_t i = 0; i <= blockSize; i++) block[i] = samples[start - 1 + std::min(i, n)];
+
+                uint16_t minimum = block[1];
+                for (size_t i = 1; i <= blockSize; i++) minimum = std::min(minimum, block[i]);
+
+                uint32_t deltaBits = 0;
+                uint32_t offsetBits = 0;
+                for (size_t i = 0; i < blockSize; i++) {
+                    deltas[i] = zigzag(int32_t(block[i + 1]) - int32_t(block[i]));
+                    offsets[i] = uint32_t(block[i + 1] - minimum);
+                    deltaBits |= deltas[i];
+                    offsetBits |= offsets[i];
+                }
+
+                // baseline mode costs the minimum (2 bytes = 4 bits per width step)
+                uint32_t deltaWidth = bitWidth(deltaBits);
+                uint32_t offsetWidth = bitWidth(offsetBits);
+                if (4 * offsetWidth + 2 < 4 * deltaWidth) {
+                    out.push_back(static_cast<uint8_t>(offsetWidth | baselineMode));
+                    out.push_back(static_cast<uint8_t>(minimum));
+                    out.push_back(static_cast<uint8_t>(minimum >> 8));
+                    pack(offsets, offsetWidth, out);
+                } else {
+                    out.push_back(static_cast<uint8_t>(deltaWidth));
+                    pack(deltas, deltaWidth, out);
+                }
+            }
+        }
+
+        // decode one channel from [data, end), advances data, false if corrupt
+        static bool decode(const uint8_t*& data, const uint8_t* end, std::vector<uint16_t>& samples) {
+            uint64_t count = 0;
+            if (!getVarint(data, end, count) || count > (1u << 24)) return false;
+            samples.resize(count);
+            if (count == 0) return true;
+
+            if (end - data < 2) return false;
+            samples[0] = static_cast<uint16_t>(data[0] | (data[1] << 8));
+            data += 2;
+
+            uint32_t deltas[blockSize];
+            for (size_t start = 1; start < count; start += blockSize) {
+                size_t n = std::min<size_t>(blockSize, count - start);
+
+                if (data >= end) return false;
+                uint32_t width = *data & ~baselineMode;
+                bool baseline = *data & baselineMode;
+                data++;
+
+                // minimum of the block
+                uint16_t minimum = 0;
+                if (baseline) {
+                    if (end - data < 2) return false;
+                    minimum = static_cast<uint16_t>(data[0] | (data[1] << 8));
+                    data += 2;
+                }
+
+                if (width > 17 || static_cast<size_t>(end - data) < 4 * width) return false;
+                unpack(data, width, deltas);
+                data += 4 * width;
+
+                // undo prediction
+                if (baseline) {
+                    for (size_t i = 0; i < n; i++) samples[start + i] = static_cast<uint16_t>(minimum + deltas[i]);
+                    continue;
+                }
+                uint16_t previous = samples[start - 1];
+                for (size_t i = 0; i < n; i++) {
+                    previous = static_cast<uint16_t>(previous + unzigzag(deltas[i]));
+                    samples[start + i] = previous;
+                }
+            }
+
+            return true;
+        }
+
+        // unsigned LEB128 varint (sample counts)
+        static void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        static bool getVarint(const uint8_t*& data, const uint8_t* end, uint64_t& value) {
+            value = 0;
+            for (int shift = 0; shift < 64 && data < end; shift += 7) {
+                uint8_t byte = *data++;
+                value |= uint64_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) return true;
+            }
+            return false;
+        }
+
+    private:
+
+        static constexpr uint8_t baselineMode = 0x80;
+
+        static uint32_t zigzag(int32_t value) { return (uint32_t(value) << 1) ^ uint32_t(value >> 31); }
+        static int32_t unzigzag(uint32_t value) { return int32_t(value >> 1) ^ -int32_t(value & 1); }
+
+        static uint32_t bitWidth(uint32_t value) {
+            uint32_t width = 0;
+            while (value) { width++; value >>= 1; }
+            return width;
+        }
+
+        // 32 values of width bits into 4 * width bytes
+        static void pack(const uint32_t* values, uint32_t width, std::vector<uint8_t>& out) {
+            if (width == 0) return;
+            uint64_t buffer = 0;
+            uint32_t filled = 0;
+            for (size_t i = 0; i < blockSize; i++) {
+                buffer |= uint64_t(values[i]) << filled;
+                filled += width;
+                while (filled >= 8) {
+                    out.push_back(static_cast<uint8_t>(buffer));
+                    buffer >>= 8;
+                    filled -= 8;
+                }
+            }
+        }
+
+        static void unpack(const uint8_t* data, uint32_t width, uint32_t* values) {
+            uint64_t buffer = 0;
+            uint32_t filled = 0;
+            uint32_t mask = width ? (uint32_t(1) << width) - 1 : 0;
+            for (size_t i = 0; i < blockSize; i++) {
+                while (filled < width) {
+                    buffer |= uint64_t(*data++) << filled;
+                    filled += 8;
+                }
+                values[i] = uint32_t(buffer) & mask;
+                buffer >>= width;
+                filled -= width;
+            }
+        }
+};
@@ -41,8 +41,11 @@ class Window : public QWidget
         QStackedWidget *stack;
         Settings *settingsWgt;
         QPushButton *startButton;
+        QPushButton *dumpButton;
+        QPushButton *calibrateButton;
 
         void onStart();
+        void onCalibrate();
 
         // error handling
         bool boolret;
@@ -2,6 +2,8 @@
 #include <QSerialPort>
 #include <QTextStream>
 #include <QLocale>
+#include <QThread>
+#include <QMetaObject>
 #include <cstdint>
 
 #include <Arduino.h>
@@ -21,16 +23,48 @@ Arduino::Arduino(
     TTH(tth)
 {
     serialPort = new QSerialPort(this);
+
+    // serial reads do not depend on the load of the GUI thread
+    serialThread = new QThread();
+    serialThread->setObjectName("Arduino");
+    moveToThread(serialThread);
+    serialThread->start();
 }
 
 Arduino::~Arduino() {
-    delete serialPort;
+
+    // serial port has to be deleted in its own thread
+    runInSerialThread([this]() {
+        delete serialPort;
+        serialPort = nullptr;
+        return true;
+    });
+
+    // stop event loop
+    serialThread->quit();
+    serialThread->wait();
+    delete serialThread;
+}
+
+bool Arduino::runInSerialThread(std::function<bool()> fn) {
+
+    // already in serial thread
+    if (QThread::currentThread() == serialThread) return fn();
+
+    // wait for the event loop of the serial thread
+    bool result = false;
+    QMetaObject::invokeMethod(this, [&]() { result = fn(); }, Qt::BlockingQueuedConnection);
+
+    return result;
 }
 
 // connection
 
 bool Arduino::open() {
 
+    // serial port is used in its own thread
+    if (QThread::currentThread() != serialThread) return runInSerialThread([this]() { return open(); });
+
     // report
     ERR->logInfo("Arduino::open");
 
@@ -66,6 +100,9 @@ bool Arduino::open() {
 
 bool Arduino::startCollecting() {
 
+    // serial port is used in its own thread
+    if (QThread::currentThread() != serialThread) return runInSerialThread([this]() { return startCollecting(); });
+
     // report
     ERR->logInfo("Arduino::startCollecting");
 
@@ -78,6 +115,8 @@ bool Arduino::startCollecting() {
 
     buffer.clear();
     serialPort->clear();
+    q.clear();
+    q.resetStatistics();
 
     // connect readyRead verbinden
     connect(serialPort, &QSerialPort::readyRead, this, &Arduino::onReadyRead);
@@ -86,6 +125,9 @@ bool Arduino::startCollecting() {
 }
 
 bool Arduino::stopCollecting() {
+
+    // serial port is used in its own thread
+    if (QThread::currentThread() != serialThread) return runInSerialThread([this]() { return stopCollecting(); });
     
     // report
     ERR->logInfo("Arduino::stopCollecting");
@@ -95,6 +137,14 @@ bool Arduino::stopCollecting() {
 
         // end collection by disconnecting slot
         disconnect(serialPort, &QSerialPort::readyRead, this, &Arduino::onReadyRead);
+        isCollecting = false;
+
+        // report queue statistics
+        ERR->logInfo(
+            "Arduino::stopCollecting: queue high-water mark " + std::to_string(q.getHighWaterMark()) +
+            " of " + std::to_string(q.getCapacity()) +
+            ", dropped " + std::to_string(q.getDropped())
+        );
     }
 
     return true;
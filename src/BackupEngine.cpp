@@ -0,0 +1,573 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <functional>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include <BackupEngine.h>
+#include <Checksum.h>
+#include <CollectorConfig.h>
+#include <ErrorHandler.h>
+#include <FileRecovery.h>
+
+
+// constructor and destructor
+
+BackupEngine::BackupEngine(
+    std::shared_ptr<CollectorConfig> cc,
+    ErrorHandler *err,
+    TaskScheduler *ts
+) : CC(cc),
+    TS(ts),
+    ERR(err)
+{}
+
+BackupEngine::~BackupEngine() {
+    stop();
+}
+
+
+// start and stop
+
+void BackupEngine::start() {
+
+    // check
+    if (timer) return;
+
+    // report
+    ERR->logInfo("BackupEngine::start");
+
+    // copies of the last run
+    queuePath = fs::path(CC->workingDir) / "backup_queue.json";
+    loadQueue();
+
+    // copy every second with the lowest priority
+    lastStep = std::chrono::steady_clock::now();
+    tokens = 0;
+    timer = TS->schedule(TaskPriority::Backup, std::chrono::seconds(1), std::chrono::seconds(1), [this]() { step(); });
+}
+
+void BackupEngine::stop() {
+    if (timer) TS->cancel(timer);
+    timer = 0;
+}
+
+
+// jobs
+
+BackupEngine::Job* BackupEngine::findJob(const fs::path& source) {
+    for (Job& job : jobs) {
+        if (!job.done && !job.cancelled && job.source == source) return &job;
+    }
+    return nullptr;
+}
+
+std::vector<fs::path> BackupEngine::destinations(const fs::path& relative) {
+    std::vector<std::string> dirs = {CC->backupDir};
+    dirs.insert(dirs.end(), CC->backupDirs.begin(), CC->backupDirs.end());
+
+    std::vector<fs::path> dests;
+    for (const std::string& dir : dirs) {
+        if (dir.empty()) continue;
+        fs::path dest = (fs::path(dir) / relative).lexically_normal();
+        if (std::find(dests.begin(), dests.end(), dest) == dests.end()) dests.push_back(dest);
+    }
+    return dests;
+}
+
+void BackupEngine::track(const fs::path& source, const fs::path& relative, std::shared_ptr<RewriteLog> rewrites) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (findJob(source)) return;
+        Job& job = jobs.emplace_back();
+        job.source = source;
+        job.dests = destinations(relative);
+        job.rewrites = std::move(rewrites);
+    }
+    saveQueue();
+}
+
+void BackupEngine::complete(const fs::path& source, const fs::path& relative) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        // every job of the file (destinations that failed have their own)
+        bool found = false;
+        for (Job& job : jobs) {
+            if (job.done || job.cancelled || job.source != source) continue;
+            job.closed = true;
+            found = true;
+
+            // try again right away
+            job.failures = 0;
+            job.retryTime = std::chrono::steady_clock::time_point();
+        }
+        if (!found) {
+            Job& job = jobs.emplace_back();
+            job.source = source;
+            job.dests = destinations(relative);
+            job.closed = true;
+        }
+    }
+    saveQueue();
+}
+
+void BackupEngine::cancel(const fs::path& source) {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (Job& job : jobs) {
+        if (job.source == source) job.cancelled = true;
+    }
+}
+
+size_t BackupEngine::getPending() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return static_cast<size_t>(std::count_if(jobs.begin(), jobs.end(), [](const Job& job) { return !job.done && !job.cancelled; }));
+}
+
+
+// copy
+
+void BackupEngine::step() {
+
+    // bytes allowed since the last step (at most two seconds saved up)
+    auto now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - lastStep).count();
+    lastStep = now;
+
+    Long64_t budget = 256 * 1048576LL;
+    if (CC->backupMBps > 0) {
+        double rate = CC->backupMBps * 1e6;
+        tokens = std::min(tokens + rate * seconds, 2 * rate);
+        budget = static_cast<Long64_t>(tokens);
+    }
+
+    // copy, the last chunk may exceed the budget (paid back in the next steps)
+    Long64_t start = budget;
+    copy(budget, false);
+    if (CC->backupMBps > 0) tokens -= static_cast<double>(start - budget);
+}
+
+void BackupEngine::drain() {
+
+    // report
+    ERR->logInfo("BackupEngine::drain: " + std::to_string(getPending()) + " file(s)");
+
+    Long64_t budget = LLONG_MAX;
+    while (copy(budget, true)) {}
+}
+
+bool BackupEngine::copy(Long64_t& budget, bool closedOnly) {
+
+    std::lock_guard<std::mutex> copyLock(copyMtx);
+    if (buffer.empty()) buffer.resize(chunkSize);
+
+    // jobs that can be copied now, closed files first
+    std::vector<Job*> runnable;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto now = std::chrono::steady_clock::now();
+        for (Job& job : jobs) {
+            if (job.done || job.cancelled || job.retryTime > now || (closedOnly && !job.closed)) continue;
+            runnable.push_back(&job);
+        }
+    }
+    std::stable_partition(runnable.begin(), runnable.end(), [](Job* job) { return job->closed.load(); });
+
+    bool progress = false;
+    for (Job* job : runnable) {
+        if (budget <= 0) break;
+        Long64_t before = budget;
+        if (copyJob(*job, budget) && (budget < before || job->done)) progress = true;
+    }
+
+    // forget finished and cancelled copies
+    bool changed = false;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (auto it = jobs.begin(); it != jobs.end();) {
+            if (it->cancelled) {
+                for (const fs::path& dest : it->dests) {
+                    std::error_code ec;
+                    fs::remove(dest.string() + ".part", ec);
+                }
+            }
+            if (it->done || it->cancelled) {
+                it = jobs.erase(it);
+                changed = true;
+            } else {
+                ++it;
+            }
+        }
+    }
+    if (changed) saveQueue();
+
+    return progress;
+}
+
+bool BackupEngine::copyJob(Job& job, Long64_t& budget) {
+
+    bool closed = job.closed.load();
+
+    // source (a file that is prepared may not exist yet)
+    int in = ::open(job.source.c_str(), O_RDONLY);
+    if (in < 0) {
+        if (!closed && errno == ENOENT) return true;
+        fail(job, "cannot open " + job.source.string() + ": " + std::strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(in, &st) != 0) {
+        ::close(in);
+        fail(job, "cannot stat " + job.source.string() + ": " + std::strerror(errno));
+        return false;
+    }
+    Long64_t size = static_cast<Long64_t>(st.st_size);
+
+    // copies, renamed when complete (an error stops the copy to that destination only)
+    size_t count = job.dests.size();
+    std::vector<int> outs(count, -1);
+    std::vector<std::string> errors(count);
+    for (size_t i = 0; i < count; i++) {
+        fs::path part = job.dests[i].string() + ".part";
+        std::error_code ec;
+        fs::create_directories(job.dests[i].parent_path(), ec);
+        outs[i] = ::open(part.c_str(), O_RDWR | O_CREAT, 0644);
+        if (outs[i] < 0) errors[i] = "cannot open " + part.string() + ": " + std::strerror(errno);
+    }
+    auto writable = [&]() { return std::any_of(errors.begin(), errors.end(), [](const std::string& e) { return e.empty(); }); };
+
+    // run for every destination, the first one on this thread (waiting runs a destination
+    // here too if no worker took it, so a busy scheduler cannot block the copy)
+    auto forEachDest = [&](const std::function<void(size_t)>& task) {
+        std::vector<TaskFuture> tasks;
+        for (size_t i = 1; i < count; i++) {
+            if (errors[i].empty()) tasks.push_back(TS->submit(TaskPriority::Backup, [&task, i]() { task(i); }));
+        }
+        if (count > 0 && errors[0].empty()) task(0);
+        for (auto& t : tasks) t.wait();
+    };
+
+    // read a range once and write it to every destination (with onlyChanged only if its hash differs from hash)
+    std::string error;
+    auto transfer = [&](Long64_t offset, Long64_t length, uint64_t& hash, bool onlyChanged) {
+        for (Long64_t done = 0; done < length;) {
+            ssize_t n = ::pread(in, buffer.data() + done, static_cast<size_t>(length - done), offset + done);
+            if (n <= 0) {
+                error = "cannot read " + job.source.string() + ": " + (n == 0 ? std::string("file is shorter") : std::strerror(errno));
+                return false;
+            }
+            done += n;
+        }
+        budget -= length;
+
+        uint64_t previous = hash;
+        hash = Checksum::xxHash64(buffer.data(), static_cast<size_t>(length));
+        if (onlyChanged && hash == previous) return true;
+
+        forEachDest([&](size_t i) {
+            for (Long64_t done = 0; done < length;) {
+                ssize_t n = ::pwrite(outs[i], buffer.data() + done, static_cast<size_t>(length - done), offset + done);
+                if (n < 0) {
+                    errors[i] = "cannot write " + job.dests[i].string() + ".part: " + std::strerror(errno);
+                    return;
+                }
+                done += n;
+            }
+        });
+        return true;
+    };
+
+    bool ok = true;
+
+    // closed: chunks the writer changed after they were copied (all of them if not known)
+    if (closed && !job.staleKnown) {
+        job.stale.clear();
+        if (job.rewrites) {
+            for (const auto& range : job.rewrites->get()) {
+                for (Long64_t index = range.first / chunkSize; index * chunkSize < range.second && index < static_cast<Long64_t>(job.hashes.size()); index++) {
+                    job.stale.push_back(static_cast<size_t>(index));
+                }
+            }
+            std::sort(job.stale.begin(), job.stale.end());
+            job.stale.erase(std::unique(job.stale.begin(), job.stale.end()), job.stale.end());
+        } else {
+            for (size_t index = 0; index < job.hashes.size(); index++) job.stale.push_back(index);
+        }
+        job.rechecked = 0;
+        job.staleKnown = true;
+    }
+    while (ok && writable() && closed && job.rechecked < job.stale.size() && budget > 0) {
+        size_t index = job.stale[job.rechecked];
+        Long64_t offset = static_cast<Long64_t>(index) * chunkSize;
+        if (offset + chunkSize > size) {
+            job.hashes.resize(index);
+            job.stale.resize(job.rechecked);
+            break;
+        }
+        ok = transfer(offset, chunkSize, job.hashes[index], true);
+        if (ok) job.rechecked++;
+    }
+    bool final = closed && job.staleKnown && job.rechecked == job.stale.size();
+
+    // new full chunks
+    while (ok && writable() && (!closed || final) && static_cast<Long64_t>(job.hashes.size() + 1) * chunkSize <= size && budget > 0) {
+        uint64_t hash = 0;
+        ok = transfer(static_cast<Long64_t>(job.hashes.size()) * chunkSize, chunkSize, hash, false);
+        if (!ok) break;
+        job.hashes.push_back(hash);
+    }
+
+    // closed and all chunks final: rest of the file, then verify and rename every copy
+    Long64_t tail = static_cast<Long64_t>(job.hashes.size()) * chunkSize;
+    if (ok && writable() && final && tail + chunkSize > size && budget > 0) {
+        uint64_t hash = 0;
+        if (size > tail) ok = transfer(tail, size - tail, hash, false);
+        if (ok) {
+            std::vector<uint64_t> hashes = job.hashes;
+            if (size > tail) hashes.push_back(hash);
+            uint64_t checksum = Checksum::combine(hashes);
+            forEachDest([&](size_t i) {
+                finishCopy(outs[i], job.dests[i], size, checksum, errors[i]);
+            });
+            for (size_t i = 0; i < count; i++) {
+                if (!errors[i].empty()) continue;
+                writeManifest(job.dests[i], size, checksum);
+                ERR->logInfo("BackupEngine::copyJob: " + job.dests[i].string() + " (xxh64 of chunks " + Checksum::hex(checksum) + ")");
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            job.done = true;
+        }
+    }
+
+    ::close(in);
+    for (int out : outs) {
+        if (out >= 0) ::close(out);
+    }
+
+    // destinations that failed (in reverse, indices stay valid)
+    bool split = false;
+    for (size_t i = count; i-- > 0;) {
+        if (errors[i].empty()) continue;
+        failDest(job, i, errors[i]);
+        split = true;
+    }
+    if (split) saveQueue();
+
+    if (!ok) {
+        fail(job, error);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    job.failures = 0;
+    return true;
+}
+
+bool BackupEngine::finishCopy(int fd, const fs::path& dest, Long64_t size, uint64_t checksum, std::string& error) {
+
+    fs::path part = dest.string() + ".part";
+    if (::ftruncate(fd, size) != 0) {
+        error = "cannot truncate " + part.string() + ": " + std::strerror(errno);
+        return false;
+    }
+    if (::fdatasync(fd) != 0) {
+        error = "cannot sync " + part.string() + ": " + std::strerror(errno);
+        return false;
+    }
+
+    // read back from the disk, not from the page cache
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    std::vector<char> data(chunkSize);
+    std::vector<uint64_t> hashes;
+    for (Long64_t offset = 0; offset < size; offset += chunkSize) {
+        Long64_t length = std::min(chunkSize, size - offset);
+        for (Long64_t done = 0; done < length;) {
+            ssize_t n = ::pread(fd, data.data() + done, static_cast<size_t>(length - done), offset + done);
+            if (n <= 0) {
+                error = "cannot read back " + part.string() + ": " + (n == 0 ? std::string("file is shorter") : std::strerror(errno));
+                return false;
+            }
+            done += n;
+        }
+        hashes.push_back(Checksum::xxHash64(data.data(), static_cast<size_t>(length)));
+    }
+    uint64_t copied = Checksum::combine(hashes);
+    if (copied != checksum) {
+        error = "checksum of " + part.string() + " is " + Checksum::hex(copied) + ", expected " + Checksum::hex(checksum);
+        return false;
+    }
+
+    std::error_code ec;
+    fs::rename(part, dest, ec);
+    if (ec) {
+        error = "cannot rename " + part.string() + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+void BackupEngine::fail(Job& job, const std::string& message) {
+
+    // retry after 5 s, 10 s, ... up to 10 min
+    int delay;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        job.failures++;
+        delay = std::min(5 << std::min(job.failures - 1, 7), 600);
+        job.retryTime = std::chrono::steady_clock::now() + std::chrono::seconds(delay);
+    }
+
+    // report
+    std::string text = "BackupEngine::copyJob: " + message + ", retry in " + std::to_string(delay) + " s";
+    if (job.failures == 1) {
+        ERR->ThrowError(text);
+    } else {
+        ERR->logInfo(text);
+    }
+}
+
+void BackupEngine::failDest(Job& job, size_t index, const std::string& message) {
+
+    Job* retry = &job;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+
+        // other destinations go on, this one gets a job of its own
+        if (job.dests.size() > 1) {
+            retry = &jobs.emplace_back();
+            retry->source = job.source;
+            retry->dests = {job.dests[index]};
+            retry->closed = job.closed.load();
+            retry->rewrites = job.rewrites;
+            retry->failures = 0;
+            job.dests.erase(job.dests.begin() + static_cast<std::ptrdiff_t>(index));
+        }
+
+        // copied again from the start
+        retry->done = false;
+        retry->hashes.clear();
+        retry->stale.clear();
+        retry->staleKnown = false;
+        retry->rechecked = 0;
+    }
+
+    fail(*retry, message);
+}
+
+
+// manifest
+
+void BackupEngine::writeManifest(const fs::path& dest, Long64_t size, uint64_t checksum) {
+
+    fs::path path = dest.parent_path() / "manifest.json";
+
+    // entries of the files copied before
+    nlohmann::json manifest = nlohmann::json::object();
+    {
+        std::ifstream file(path);
+        if (file.good()) {
+            try {
+                manifest = nlohmann::json::parse(file);
+            } catch (const std::exception& e) {
+                ERR->logInfo("BackupEngine::writeManifest: " + path.string() + " is rewritten: " + e.what());
+                manifest = nlohmann::json::object();
+            }
+        }
+    }
+    manifest[dest.filename().string()] = {{"size", size}, {"chunkSize", chunkSize}, {"chunkXxh64", Checksum::hex(checksum)}};
+
+    // replace the manifest at once
+    fs::path temp = path.string() + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::trunc);
+        file << manifest.dump(2);
+        if (!file.good()) {
+            ERR->ThrowError("BackupEngine::writeManifest: cannot write " + temp.string());
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp, path, ec);
+    if (ec) ERR->ThrowError("BackupEngine::writeManifest: cannot rename " + temp.string() + ": " + ec.message());
+}
+
+
+// queue file
+
+void BackupEngine::saveQueue() {
+
+    // check
+    if (queuePath.empty()) return;
+
+    nlohmann::json queue = nlohmann::json::array();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const Job& job : jobs) {
+            if (job.done || job.cancelled) continue;
+            nlohmann::json dests = nlohmann::json::array();
+            for (const fs::path& dest : job.dests) dests.push_back(dest.string());
+            queue.push_back({{"source", job.source.string()}, {"dests", dests}, {"closed", job.closed.load()}});
+        }
+    }
+
+    // replace the queue file at once
+    fs::path temp = queuePath.string() + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::trunc);
+        file << queue.dump(2);
+        if (!file.good()) {
+            ERR->logInfo("BackupEngine::saveQueue: cannot write " + temp.string());
+            return;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp, queuePath, ec);
+}
+
+void BackupEngine::loadQueue() {
+
+    // check
+    std::ifstream file(queuePath);
+    if (!file.good()) return;
+
+    try {
+        nlohmann::json queue = nlohmann::json::parse(file);
+
+        // files still listed in a marker of the working directory
+        std::vector<fs::path> open;
+        for (const fs::path& marker : FileRecovery::findMarkers(CC->workingDir)) {
+            for (const fs::path& path : FileRecovery::readMarker(marker)) open.push_back(path);
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& entry : queue) {
+            // files removed meanwhile are never completed
+            fs::path source = entry.at("source").get<std::string>();
+            std::error_code ec;
+            if (!fs::exists(source, ec)) {
+                ERR->logInfo("BackupEngine::loadQueue: " + source.string() + " no longer exists");
+                continue;
+            }
+
+            // copied again from the start
+            Job& job = jobs.emplace_back();
+            job.source = source;
+            for (const auto& dest : entry.at("dests")) job.dests.push_back(dest.get<std::string>());
+            // closed if the writer finished it (files of a marker are completed by the recovery)
+            job.closed = entry.value("closed", true) || std::find(open.begin(), open.end(), source) == open.end();
+        }
+    } catch (const std::exception& e) {
+        ERR->ThrowError(std::string("BackupEngine::loadQueue: ") + e.what());
+        return;
+    }
+
+    // report
+    ERR->logInfo("BackupEngine::loadQueue: " + std::to_string(getPending()) + " file(s) of the last run");
+}
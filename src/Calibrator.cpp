@@ -0,0 +1,208 @@
+#include <filesystem>
+#include <fstream>
+#include <ctime>
+#include <cmath>
+
+#include <Calibrator.h>
+#include <ConfigHandler.h>
+#include <CollectorConfig.h>
+#include <DigitizerConfig.h>
+#include <ErrorHandler.h>
+
+namespace fs = std::filesystem;
+
+
+// constructor
+
+Calibrator::Calibrator(
+    std::shared_ptr<CollectorConfig> cc,
+    std::shared_ptr<DigitizerConfig> dc,
+    ErrorHandler *err
+) : CC(cc),
+    DC(dc),
+    ERR(err)
+{}
+
+
+// calibration
+
+bool Calibrator::run(CalibrationDevice& device, bool simulated) {
+
+    // report
+    ERR->logInfo(std::string("Calibrator::run") + (simulated ? ": simulated digitizer" : ""));
+
+    std::array<ChannelResult,3> results;
+
+    for (int channel = 0; channel <= 2; channel++) {
+
+        // keep settings of inactive channels
+        results[channel].dcOffset = DC->dcOffset[channel];
+        results[channel].threshold = DC->triggerThreshold[channel];
+        if (!DC->active[channel]) continue;
+
+        // centre baseline
+        if (!calibrateBaseline(device, channel, results[channel])) return false;
+
+        // rate versus threshold
+        if (!sweepThresholds(device, channel, results[channel])) return false;
+
+        // report
+        ERR->logInfo(
+            "Calibrator::run: channel " + std::to_string(channel) +
+            ": dcOffset " + std::to_string(results[channel].dcOffset) +
+            ", baseline " + std::to_string(results[channel].baseline) +
+            ", suggested triggerThreshold " + std::to_string(results[channel].threshold)
+        );
+    }
+
+    return writeResults(results, simulated);
+}
+
+bool Calibrator::calibrateBaseline(CalibrationDevice& device, int channel, ChannelResult& result) {
+
+    // measure baseline for a DC offset
+    auto measure = [&](uint16_t dcOffset, double& mean, double& rms) {
+        if (!device.setChannelDCOffset(channel, dcOffset)) return false;
+        return device.measureBaseline(channel, CC->calibrationBaselineTriggers, mean, rms);
+    };
+
+    double target = CC->calibrationBaselineTarget;
+    double mean = 0, rms = 0;
+
+    // direction of the baseline shift
+    double meanLow = 0, meanHigh = 0;
+    if (!measure(0, meanLow, rms)) return false;
+    if (!measure(65535, meanHigh, rms)) return false;
+    bool rising = meanHigh > meanLow;
+
+    // bisection of the DC offset
+    int low = 0, high = 65535;
+    int dcOffset = DC->dcOffset[channel];
+
+    while (low <= high) {
+        dcOffset = low + (high - low) / 2;
+        if (!measure(static_cast<uint16_t>(dcOffset), mean, rms)) return false;
+
+        // close enough
+        if (std::abs(mean - target) <= CC->calibrationBaselineTolerance) break;
+
+        if ((mean < target) == rising) low = dcOffset + 1;
+        else high = dcOffset - 1;
+    }
+
+    result.dcOffset = static_cast<uint16_t>(dcOffset);
+    result.baseline = mean;
+    result.baselineRMS = rms;
+
+    return true;
+}
+
+bool Calibrator::sweepThresholds(CalibrationDevice& device, int channel, ChannelResult& result) {
+
+    // thresholds move away from the baseline in pulse direction
+    double sign = DC->polarityPositive[channel] ? 1.0 : -1.0;
+    int steps = std::max(CC->calibrationThresholdSteps, 2);
+
+    bool suggested = false;
+
+    for (int step = 0; step < steps; step++) {
+
+        double distance = CC->calibrationThresholdStart +
+            (CC->calibrationThresholdEnd - CC->calibrationThresholdStart) * step / (steps - 1.0);
+
+        long value = std::lround(result.baseline + sign * distance);
+        if (value < 0 || value > 4095) break;
+        uint16_t threshold = static_cast<uint16_t>(value);
+
+        // count triggers
+        uint64_t triggers = 0;
+        double liveTime = 0;
+        if (!device.setChannelTriggerThreshold(channel, threshold)) return false;
+        if (!device.countTriggers(channel, CC->calibrationMeasureTime, triggers, liveTime)) return false;
+
+        double rate = liveTime > 0 ? triggers / liveTime : 0;
+        double rateError = liveTime > 0 ? std::sqrt(static_cast<double>(triggers)) / liveTime : 0;
+        result.curve.push_back({threshold, triggers, rate, rateError});
+
+        // first threshold below the target rate
+        if (!suggested && rate <= CC->targetTriggerRate) {
+            result.threshold = threshold;
+            suggested = true;
+        }
+    }
+
+    // fall back to the last point of the sweep
+    if (!suggested && !result.curve.empty()) {
+        result.threshold = result.curve.back().threshold;
+        ERR->logInfo("Calibrator::sweepThresholds: channel " + std::to_string(channel) + ": target rate not reached");
+    }
+
+    // restore threshold, the suggestion is not applied
+    return device.setChannelTriggerThreshold(channel, DC->triggerThreshold[channel]);
+}
+
+
+// write results
+
+bool Calibrator::writeResults(const std::array<ChannelResult,3>& results, bool simulated) {
+
+    // file name from current time
+    auto t = std::time(nullptr);
+    std::tm tm{};
+    gmtime_r(&t, &tm);
+
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y_%m_%d_%H_%M_%S", &tm);
+    fs::path filePath = fs::path(CC->workingDir) / "calibration" / (static_cast<std::string>(buf) + "_calibration.json");
+
+    // suggested settings
+    DigitizerConfig suggested = *DC;
+
+    nlohmann::json j;
+    j["simulated"] = simulated;
+    j["targetTriggerRate"] = CC->targetTriggerRate;
+    j["baselineTarget"] = CC->calibrationBaselineTarget;
+
+    for (int channel = 0; channel <= 2; channel++) {
+        const ChannelResult& result = results[channel];
+
+        nlohmann::json jc;
+        jc["channel"] = channel;
+        jc["active"] = DC->active[channel];
+        jc["dcOffset"] = result.dcOffset;
+        jc["baseline"] = result.baseline;
+        jc["baselineRMS"] = result.baselineRMS;
+        jc["triggerThreshold"] = result.threshold;
+
+        for (const CurvePoint& point : result.curve) {
+            jc["curve"].push_back({
+                {"threshold", point.threshold},
+                {"triggers", point.triggers},
+                {"rate", point.rate},
+                {"rateError", point.rateError}
+            });
+        }
+
+        j["channels"].push_back(jc);
+
+        suggested.dcOffset[channel] = result.dcOffset;
+        suggested.triggerThreshold[channel] = result.threshold;
+    }
+
+    j["suggestedDigitizerConfig"] = suggested;
+
+    // create folder if it doesnt exist
+    fs::create_directories(filePath.parent_path());
+
+    std::ofstream out(filePath);
+    if (!out.is_open()) {
+        ERR->ThrowError("Calibrator::writeResults: error when opening " + filePath.string());
+        return false;
+    }
+    out << j.dump(4);
+
+    // report
+    ERR->logInfo("Calibrator::writeResults: " + filePath.string());
+
+    return true;
+}
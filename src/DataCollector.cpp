@@ -2,6 +2,9 @@
 #include <DataCollector.h>
 #include <Arduino.h>
 
+#include <cmath>
+#include <limits>
+
 
 // constructor
 
@@ -12,11 +15,35 @@ DataCollector::DataCollector(
     std::shared_ptr<TimeTagHandler> tth
 )
   : CC(cc),
-    DW(cc, dc, err, tth),
-    RTW(cc, err),
+    DC(dc),
+    TS(cc, err),
+    DW(cc, dc, err, tth, &TS),
+    RTW(cc, dc, err, &TS),
     AD(cc, err, tth),
+    FR(cc, err, &TS),
+    FE(dc),
+    CAL(cc, dc, err),
     ERR(err)
-{}
+{
+    // start workers
+    TS.start();
+
+    // allocation sites that grow with the rate
+    memQueue = MA.registerComponent("digitizer queue");
+    memFlightRecorder = MA.registerComponent("flight recorder");
+    memBaskets = MA.registerComponent("ROOT baskets");
+
+    // producers schedule the processing
+    NT.setCallback([this]() { TS.submit(TaskPriority::Processing, [this]() { processingTask(); }); });
+    DW.setNotifier(&NT);
+    AD.setNotifier(&NT);
+}
+
+DataCollector::~DataCollector() {
+
+    // finish queued tasks while all components exist
+    TS.stop();
+}
 
 
 // handeling connections
@@ -90,6 +117,12 @@ bool DataCollector::startAcquisition() {
     // report
     ERR->logInfo("DataCollector::startAcquisition");
 
+    // check
+    if (isCalibrating.load()) {
+        ERR->ThrowError("Tried to start acquisition, but calibration is running");
+        return false;
+    }
+
     // start Digitizer
     boolret = DW.startCollecting();
     if (ERR->CheckError(boolret, "DW.startCollecting")) return false;
@@ -112,10 +145,26 @@ bool DataCollector::startAcquisition() {
     return true;
 }
 
+std::vector<RateValue> DataCollector::getRates() {
+
+    // lock block for threadsafe
+    std::lock_guard<std::mutex> lock(rateMtx);
+    return rates;
+}
+
 void DataCollector::joinRTWBackup() {
     RTW.joinBackup();
 }
 
+void DataCollector::dumpFlightRecorder() {
+
+    // dump is started by the reading loop
+    if (CC->enableFlightRecorder) {
+        FR.requestDump("operator");
+        NT.notify();
+    }
+}
+
 bool DataCollector::stopAcquisition() {
 
     // report
@@ -138,16 +187,169 @@ bool DataCollector::stopAcquisition() {
     return true;
 }
 
+bool DataCollector::startCalibration() {
+
+    // report
+    ERR->logInfo("DataCollector::startCalibration");
+
+    // check
+    if (isCalibrating.load() || isReading.load()) {
+        ERR->ThrowError("Tried to start calibration, but digitizer is busy");
+        return false;
+    }
+
+    // set status
+    joinCalibration();
+    isCalibrating.store(true);
+
+    // start calibration
+    calibration = TS.submit(TaskPriority::Processing, [this]() { calibrationLoop(); });
+
+    return true;
+}
+
+void DataCollector::joinCalibration() {
+
+    // wait till calibration is finished
+    if (calibration.valid()) calibration.wait();
+}
+
+void DataCollector::calibrationLoop() {
+
+    // simulated digitizer
+    if (CC->simulateDigitizer) {
+        SimulatedDigitizer SD(DC);
+        boolret = CAL.run(SD, true);
+        ERR->CheckError(boolret, "CAL.run");
+        isCalibrating.store(false);
+        return;
+    }
+
+    // open digitizer if needed
+    bool wasOpen;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        wasOpen = isOpen;
+    }
+
+    if (!wasOpen) {
+        boolret = DW.open();
+        if (ERR->CheckError(boolret, "DW.open")) {
+            isCalibrating.store(false);
+            return;
+        }
+    }
+
+    // configure digitizer
+    boolret = DW.applyConfig();
+    if (!ERR->CheckError(boolret, "DW.applyConfig")) {
+
+        boolret = CAL.run(DW, false);
+        ERR->CheckError(boolret, "CAL.run");
+
+        // restore configured settings
+        boolret = DW.applyConfig();
+        ERR->CheckError(boolret, "DW.applyConfig");
+    }
+
+    // close digitizer, if it was opened here
+    if (!wasOpen) {
+        boolret = DW.close();
+        ERR->CheckError(boolret, "DW.close");
+    }
+
+    // status
+    isCalibrating.store(false);
+}
+
 bool DataCollector::startReading() {
 
     // report
     ERR->logInfo("DataCollector::startReading");
 
+    // no processing while the state is prepared
+    std::lock_guard<std::mutex> lock(readingMtx);
+
+    // open File in RootTreeWriter
+    if (!RTW.getFileOpen()) {
+        boolret = RTW.openNewFile();
+        if (ERR->CheckError(boolret, "RTW.OpenNewFile")) return false;
+    }
+
+    // rotation policies of the config, first file starts now
+    RP = CombinedRotation::fromConfig(*CC);
+    startFilePeriod(getNow());
+    newestEventTime = 0;
+    partitionStart = RTW.getPartitionStart(getNow());
+    if (RTW.getPartitioned()) {
+        AS.reset(CC->acquisitionLimitMode, CC->acquisitionLimit, CC->acquisitionLimitBuckets, partitionStart, partitionStart + static_cast<Long64_t>(CC->rotationPeriod * 1e9));
+    }
+
+    // start with empty flight recorder
+    FR.clear();
+    rateAboveLimit = false;
+
+    // start without environment readings
+    EC.clear();
+    heldFeatures.clear();
+
+    // start rate windows without events (at the start, so readings before the first event have a rate)
+    RE.configure(CC->rateWindows, CC->rateBuckets);
+    RE.advance(getNow());
+
+    // start burst detection without history
+    BD.configure(CC->burstTimescales, CC->burstSignificance, CC->burstBaselineTime);
+    BD.reset();
+
+    // water marks the queue can reach (a full queue blocks or drops before the high-water mark)
+    size_t queueCapacity = static_cast<size_t>(std::max(CC->digitizerQueueCapacity, 2));
+    size_t highWater = std::clamp<size_t>(static_cast<size_t>(std::max(CC->backpressureHighWater, 1)), 1, queueCapacity * 3 / 4);
+    size_t lowWater = std::min({static_cast<size_t>(std::max(CC->backpressureLowWater, 0)), queueCapacity / 10, highWater - 1});
+    if (highWater != static_cast<size_t>(CC->backpressureHighWater) || lowWater != static_cast<size_t>(CC->backpressureLowWater)) {
+        ERR->logInfo(
+            "DataCollector::startReading: backpressure water marks " + std::to_string(highWater) + " / " + std::to_string(lowWater) +
+            " for a queue of " + std::to_string(queueCapacity) + " events"
+        );
+    }
+
+    // start with full waveforms
+    BP.configure(
+        highWater,
+        lowWater,
+        static_cast<Long64_t>(CC->backpressureMaxLag * 1e9),
+        static_cast<Long64_t>(CC->backpressureHoldTime * 1e9)
+    );
+    BP.reset(getNow());
+    recordLevel(getNow(), 0, 0);
+
+    // start threshold control with the applied thresholds
+    TC.configure(
+        CC->targetTriggerRate,
+        CC->thresholdControlTolerance,
+        static_cast<uint16_t>(std::clamp(CC->thresholdControlMin, 0, 4095)),
+        static_cast<uint16_t>(std::clamp(CC->thresholdControlMax, 0, 4095)),
+        static_cast<uint16_t>(std::clamp(CC->thresholdControlStep, 1, 4095)),
+        static_cast<Long64_t>(CC->thresholdControlInterval * 1e9)
+    );
+    thresholdControlStarted = false;
+
+    arduinoEventCounter = 0;
+    digitizerEventCounter = 0;
+    loopCount = 0;
+
+    // memory budget
+    MA.setBudget(static_cast<size_t>(std::max(CC->memoryBudget, 0)) * 1048576);
+    nextMemoryReport = getNow();
+
+    // first checkpoint after one interval
+    nextCheckpoint = getNow() + static_cast<Long64_t>(CC->checkpointInterval * 1e9);
+
     // set status
+    isStopping.store(false);
     isReading.store(true);
 
-    // start readingLoop
-    readData = std::thread(&DataCollector::readingLoop, this);
+    // file rotation and flight recorder dumps also without new data
+    housekeepingTimer = TS.schedule(TaskPriority::Processing, housekeepingInterval, housekeepingInterval, [this]() { NT.notify(); });
 
     return true;
 }
@@ -160,143 +362,367 @@ bool DataCollector::stopReading() {
     // stop is triggered by setting flag isReading to false
     isReading.store(false);
 
-    // wait tread to end
-    if (readData.joinable()) readData.join();
+    // remove housekeeping
+    TS.cancel(housekeepingTimer);
+    housekeepingTimer = 0;
+
+    // wait for a running processingTask
+    std::lock_guard<std::mutex> lock(readingMtx);
+
+    // no more readings, write the held features
+    writeFeatures(std::numeric_limits<Long64_t>::max());
 
     return true;
 }
 
-void DataCollector::readingLoop() {
+void DataCollector::processingTask() {
 
-    // open File in RootTreeWriter
-    if (!RTW.getFileOpen()) {
-        boolret = RTW.openNewFile();
-        if (ERR->CheckError(boolret, "RTW.OpenNewFile")) return;
+    bool ok = true;
+    {
+        std::lock_guard<std::mutex> lock(readingMtx);
+        if (isReading.load() && !isStopping.load()) ok = processQueues();
     }
 
-    // get current hour function
-    auto getCurrentHour = []() {
-        std::time_t t = std::time(nullptr);
-        std::tm tm{};
-        localtime_r(&t, &tm);
-        return tm.tm_hour;
-    };
+    // stop acquisition in a separate task (it waits for this one, isReading stays set for its cleanup)
+    if (!ok) {
+        isStopping.store(true);
+        TS.submit(TaskPriority::Processing, [this]() { stopAcquisition(); });
+    }
 
-    int currentHour = getCurrentHour();
+    // allow the next run, run again if data arrived meanwhile
+    NT.done();
+    if (isReading.load() && !isStopping.load() && (DW.getQueueSize() > 0 || AD.getQueueSize() > 0)) NT.notify();
+}
+
+bool DataCollector::processQueues() {
+
+    // report
+    if (CC->detailedLog) {
+        ERR->logInfo("DataCollector::processQueues: loopCount: " + std::to_string(loopCount));
+    }
+
+    // partitions follow the event time (queue empty: all events up to now are processed)
+    if (RTW.getPartitioned()) {
+        Long64_t watermark = DW.getQueueSize() == 0 ? getNow() : newestEventTime;
+        boolret = RTW.advancePartitions(watermark);
+        if (ERR->CheckError(boolret, "advancePartitions")) return false;
+        updatePartition(watermark);
+    }
+
+    // size of the current file
+    Long64_t now = getNow();
+    Long64_t lead = static_cast<Long64_t>(CC->rotationPrepareLead * 1e9);
+    Long64_t boundary = RP->getBoundary();
+    RotationState fileState;
+    fileState.bytes = CC->rotationMaxMB > 0 ? RTW.getFileBytes() : 0;
+    fileState.events = digitizerEventCounter;
+
+    // open next file in the background shortly before the rotation (named after the time boundary if that comes first)
+    if (!RTW.getPartitioned() && !nextFilePrepared && RP->soon(fileState, now, lead)) {
+        RTW.prepareNextFile(boundary >= 0 && boundary - now <= lead ? boundary : now);
+        nextFilePrepared = true;
+    }
+
+    // file check
+    if (!RTW.getPartitioned() && RP->due(fileState, now)){
+
+        // features belong to the file of their events
+        writeFeatures(std::numeric_limits<Long64_t>::max());
+
+        boolret = RTW.rotateFile(boundary >= 0 && now >= boundary ? boundary : now);
+        if (ERR->CheckError(boolret, "rotateFile")) return false;
+
+        // reset digitizerEventCounter
+        digitizerEventCounter = 0;
+
+        // next rotation and acquisition limit of the new file
+        startFilePeriod(now);
+
+        // data2 entries of the previous file are not valid anymore
+        EC.resetEntries();
+
+        // every file starts with the current degradation level
+        recordLevel(getNow(), DW.getQueueSize(), 0);
+    }
+
+    // check memory before the queue is drained
+    bool overBudget = updateMemory();
+
+    // thresholds set in the digitizer (changed between readout blocks)
+    std::array<uint16_t,3> appliedThresholds = DW.getTriggerThresholds();
+
+    // Get Data from Digitizer
+    while (auto DDataOpt = DW.getDigitizerData()) {
+        
+        // get Data out of Queue
+        DigitizerData DData = std::move(*DDataOpt);
 
-    int arduinoEventCounter = 0;
-    int digitizerEventCounter = 0;
-    uint64_t loopCount = 0;
-    
-    while (isReading.load())
-    {   
         // report
         if (CC->detailedLog) {
-            ERR->logInfo("DataCollector::readingLoop: loopCount: " + std::to_string(loopCount));
+            ERR->logInfo("DataCollector::processQueues: Digitizer eventID: " + std::to_string(DData.eventID));
         }
 
-        // file check
-        if (currentHour != getCurrentHour()){
-            boolret = RTW.closeCurrentFile();
-            if (ERR->CheckError(boolret, "closeCurrentFile")) { 
-                stopAcquisition(); 
-                return; 
-            }
+        // time up to which events are processed
+        newestEventTime = std::max(newestEventTime, DData.eventTime);
 
-            boolret = RTW.openNewFile();
-            if (ERR->CheckError(boolret, "openNewFile")) { 
-                stopAcquisition(); 
-                return; 
-            }
+        // look for sudden rate jumps
+        if (CC->enableBurstDetection) BD.addEvent(DData.eventTime, [this](const BurstAlarm& alarm) { onBurstAlarm(alarm); });
 
-            // update current hour
-            currentHour = getCurrentHour();
+        // check memory regularly during long bursts
+        if (digitizerEventCounter % 256 == 0) overBudget = updateMemory();
 
-            // reset digitizerEventCounter
-            digitizerEventCounter = 0;
+        // adapt degradation level to queue depth, writer lag and memory
+        if (CC->enableBackpressure) {
+            Long64_t now = getNow();
+            Long64_t lag = now - DData.eventTime;
+            size_t queueDepth = DW.getQueueSize();
+
+            if (BP.update(queueDepth, lag, overBudget, now)) {
+                ERR->logInfo("DataCollector::processQueues: degradation level: " + BackpressureController::levelName(BP.getLevel()));
+                recordLevel(DData.eventTime, queueDepth, lag);
+            }
         }
 
-        // Get Data from Digitizer
-        while (auto DDataOpt = DW.getDigitizerData()) {
-            
-            // get Data out of Queue
-            DigitizerData DData = std::move(*DDataOpt);
+        DegradationLevel level = BP.getLevel();
 
-            // report
-            if (CC->detailedLog) {
-                ERR->logInfo("DataCollector::readingLoop: Digitizer eventID: " + std::to_string(DData.eventID));
-            }
+        // keep full waveform in flight recorder
+        if (CC->enableFlightRecorder) FR.addEvent(DData);
 
-            // add time stamps to calculate rate
-            RC.addElement(DData.eventTime);
+        // features of the event
+        DigitizerFeatures features = FE.extract(DData);
 
-            // prepare data1 to write
-            if (!CC->enableAcquisitionLimit || digitizerEventCounter < CC->acquisitionLimit) {
+        // rates per channel and of coincidences
+        RE.addEvent(DData.eventTime, FE.firedChannels(features, appliedThresholds));
 
-                // report
-                if (CC->detailedLog) {
-                    ERR->logInfo("DataCollector::readingLoop: digitizerEventCount: " + std::to_string(digitizerEventCounter));
-                }
+        // hold target trigger rate
+        if (CC->enableThresholdControl) {
+
+            // intervals are measured in event time
+            if (!thresholdControlStarted) {
+                TC.reset(*DC, appliedThresholds, DData.eventTime);
+                thresholdControlStarted = true;
+            }
+
+            TC.addEvent(features);
 
-                RTW.set_data1(
-                    DData.eventTime, 
-                    std::move(DData.ch0), 
-                    std::move(DData.ch1), 
-                    std::move(DData.ch2)
-                );
+            std::array<uint16_t,3> thresholds;
+            if (TC.update(DData.eventTime, thresholds)) {
+                for (int channel = 0; channel <= 2; channel++) {
+                    if (thresholds[channel] != appliedThresholds[channel]) {
+                        DW.requestTriggerThreshold(channel, thresholds[channel]);
+                    }
+                }
             }
+        }
 
-            // increase eventCoutner
+        // only count the event
+        if (level == DegradationLevel::CountsOnly) {
             digitizerEventCounter++;
+            continue;
         }
 
-        // Get Data from Arduino
-        if (auto ADDataOpt = AD.getArduinoData()) {
+        // features of every event, written with the environment when the next reading is there
+        heldFeatures.push_back({DData.eventTime, DData.eventID, features});
+        if (heldFeatures.size() > maxHeldFeatures) writeFeatures(heldFeatures.front().time);
 
-            // get Data out of Queue
-            ArduinoData ADData = std::move(*ADDataOpt); 
+        // prepare data1 to write
+        if (level <= DegradationLevel::TrimmedWaveforms && (!CC->enableAcquisitionLimit || AS.accept(DData.eventTime))) {
 
             // report
             if (CC->detailedLog) {
-                ERR->logInfo("DataCollector::readingLoop: Arduino eventID: " + std::to_string(ADData.eventID));
+                ERR->logInfo("DataCollector::processQueues: digitizerEventCount: " + std::to_string(digitizerEventCounter));
             }
 
-            // get rate
-            double rate = RC.calcRate();
-
-            // check whether  rate exists
-            if (rate != std::numeric_limits<double>::quiet_NaN()) {
-                
-                // prepare data2 to write
-                RTW.set_data2(ADData.event_time, rate, ADData.arduino_p);
-
-                // prepare data3 to write
-                if (arduinoEventCounter>5) {
-                    RTW.set_data3(
-                        ADData.event_time, 
-                        ADData.tanca_h1, 
-                        ADData.tanca_t1, 
-                        ADData.tanca_h2, 
-                        ADData.tanca_t2, 
-                        ADData.tanca_h3, 
-                        ADData.tanca_t3, 
-                        ADData.tanca_h4, 
-                        ADData.tanca_t4
-                    );
-                    arduinoEventCounter = -1;
-                }
+            // reduce waveforms
+            if (level == DegradationLevel::TrimmedWaveforms) trimWaveforms(DData);
 
-                arduinoEventCounter++;
-            } else {
-                ERR->ThrowError("DataCollector::readingLoop: Arduino eventID: " + std::to_string(ADData.eventID) + " has no rate");
-            }
-            
+            RTW.set_data1(std::move(DData));
+        }
+
+        // increase eventCoutner
+        digitizerEventCounter++;
+    }
+
+    // Get Data from Arduino
+    while (auto ADDataOpt = AD.getArduinoData()) {
+
+        // get Data out of Queue
+        ArduinoData ADData = std::move(*ADDataOpt); 
 
+        // report
+        if (CC->detailedLog) {
+            ERR->logInfo("DataCollector::processQueues: Arduino eventID: " + std::to_string(ADData.eventID));
         }
-        
-        // wait 500ms
-        usleep(500000);
-        loopCount++;
+
+        // get rate of the first window (also drops old events if the digitizer stalls)
+        RE.advance(ADData.event_time);
+        double rate = RE.getRate(0).rate[RateEvents];
+
+        // no rate only for readings of the start time (nothing covered yet), written as NaN
+        if (std::isnan(rate) && ADData.event_time > RE.getStartTime()) {
+            ERR->ThrowError("DataCollector::processQueues: Arduino eventID: " + std::to_string(ADData.eventID) + " has no rate");
+        }
+
+        // prepare data2 to write
+        RTW.set_data2(ADData.event_time, rate, ADData.arduino_p);
+        Long64_t data2Entry = RTW.getData2Entries(ADData.event_time) - 1;
+
+        // dump flight recorder when the rate exceeds the limit (once till it is below again)
+        bool aboveLimit = CC->flightRecorderRateLimit > 0 && rate > CC->flightRecorderRateLimit;
+        if (CC->enableFlightRecorder && aboveLimit && !rateAboveLimit) {
+            FR.requestDump("rate");
+        }
+        rateAboveLimit = aboveLimit;
+
+        // prepare data3 to write
+        if (arduinoEventCounter>5) {
+            RTW.set_data3(
+                ADData.event_time, 
+                ADData.tanca_h1, 
+                ADData.tanca_t1, 
+                ADData.tanca_h2, 
+                ADData.tanca_t2, 
+                ADData.tanca_h3, 
+                ADData.tanca_t3, 
+                ADData.tanca_h4, 
+                ADData.tanca_t4
+            );
+            arduinoEventCounter = -1;
+        }
+
+        arduinoEventCounter++;
+
+        // keep reading for the following digitizer events
+        EC.addReading(ADData.event_time, ADData.arduino_p, ADData.arduino_t, data2Entry);
+    }
+
+    // features of the events before the newest reading (later ones after environmentWait without it)
+    writeFeatures(std::max(EC.getLatest(), getNow() - static_cast<Long64_t>(CC->environmentWait * 1e9)));
+    
+
+    // write flight recorder dump in background
+    if (CC->enableFlightRecorder) FR.checkDump();
+
+    // publish rates
+    {
+        std::lock_guard<std::mutex> lock(rateMtx);
+        rates = RE.getRates();
+    }
+
+    // report memory usage
+    updateMemory();
+    if (getNow() >= nextMemoryReport) {
+        ERR->logInfo("DataCollector::processQueues: memory: " + MA.report());
+        nextMemoryReport = getNow() + static_cast<Long64_t>(CC->memoryReportInterval * 1e9);
+    }
+
+    // make the written data recoverable
+    if (CC->checkpointInterval > 0 && getNow() >= nextCheckpoint) {
+        RTW.checkpoint();
+        MA.set(memBaskets, 0);
+        nextCheckpoint = getNow() + static_cast<Long64_t>(CC->checkpointInterval * 1e9);
+    }
+
+    loopCount++;
+
+    return true;
+}
+
+Long64_t DataCollector::getNow() {
+
+    // current time in ns
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<Long64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+void DataCollector::updatePartition(Long64_t watermark) {
+
+    // check
+    Long64_t start = RTW.getPartitionStart(watermark);
+    if (start <= partitionStart) return;
+    partitionStart = start;
+
+    // new partition: event counter, acquisition limit and degradation level start again
+    digitizerEventCounter = 0;
+    AS.reset(CC->acquisitionLimitMode, CC->acquisitionLimit, CC->acquisitionLimitBuckets, partitionStart, partitionStart + static_cast<Long64_t>(CC->rotationPeriod * 1e9));
+    recordLevel(partitionStart, DW.getQueueSize(), 0);
+}
+
+void DataCollector::startFilePeriod(Long64_t now) {
+
+    // next rotation
+    RP->reset(now);
+    nextFilePrepared = false;
+
+    // spread acquisition limit over the file (an hour if it is not time based)
+    Long64_t end = RP->getBoundary() >= 0 ? RP->getBoundary() : now + 3600000000000LL;
+    AS.reset(CC->acquisitionLimitMode, CC->acquisitionLimit, CC->acquisitionLimitBuckets, now, end);
+}
+
+void DataCollector::recordLevel(Long64_t ts, size_t queueDepth, Long64_t lag) {
+
+    // record degradation level in the current file
+    RTW.set_degradation(ts, static_cast<Int_t>(BP.getLevel()), static_cast<Long64_t>(queueDepth), lag / 1e9);
+}
+
+bool DataCollector::updateMemory() {
+
+    // estimate of one queued event
+    size_t activeChannels = (DC->active[0] ? 1 : 0) + (DC->active[1] ? 1 : 0) + (DC->active[2] ? 1 : 0);
+    size_t eventBytes = sizeof(DigitizerData) + activeChannels * DC->recordLength * sizeof(UShort_t);
+
+    // usage of every component
+    MA.set(memQueue, DW.getQueueSize() * eventBytes);
+    MA.set(memFlightRecorder, FR.getMemory());
+    MA.set(memBaskets, RTW.getUnflushedBytes());
+
+    // write baskets early (at least 1 MB, so a full queue does not flush every time)
+    if (MA.exceeds(CC->memoryFlushFraction) && RTW.getUnflushedBytes() > 1048576) {
+        ERR->logInfo("DataCollector::updateMemory: flush baskets early: " + MA.report());
+        RTW.flushBaskets();
+        MA.set(memBaskets, 0);
     }
 
+    // step down the degradation level
+    return MA.exceeds(1.0);
+}
+
+void DataCollector::onBurstAlarm(const BurstAlarm& alarm) {
+
+    // report and record burst alarm
+    ERR->logInfo(
+        "DataCollector::processQueues: burst alarm at " + std::to_string(alarm.time) + " ns" +
+        ": timescale " + std::to_string(alarm.timescale) + " s" +
+        ", counts " + std::to_string(alarm.counts) +
+        ", expected " + std::to_string(alarm.expected) +
+        ", significance " + std::to_string(alarm.significance)
+    );
+    RTW.set_alarm(alarm);
+
+    if (CC->enableFlightRecorder && CC->burstDumpFlightRecorder) FR.requestDump("burst");
+}
+
+void DataCollector::writeFeatures(Long64_t upTo) {
+
+    // events in processing order
+    while (!heldFeatures.empty() && heldFeatures.front().time <= upTo) {
+        const HeldFeatures& held = heldFeatures.front();
+        RTW.set_features(held.time, held.eventID, held.features, EC.get(held.time, RTW.getPartitionStart(held.time)));
+        heldFeatures.pop_front();
+    }
+}
+
+void DataCollector::trimWaveforms(DigitizerData& DData) {
+
+    // keep a quarter of the window before the trigger
+    size_t length = static_cast<size_t>(std::max(CC->trimmedSamples, 1));
+    size_t trigger = DC->recordLength * (100 - DC->postTriggerPct) / 100;
+    size_t begin = trigger > length / 4 ? trigger - length / 4 : 0;
+
+    for (std::vector<UShort_t>* channel : {&DData.ch0, &DData.ch1, &DData.ch2}) {
+        if (begin >= channel->size()) continue;
+        size_t end = std::min(begin + length, channel->size());
+        channel->erase(channel->begin() + end, channel->end());
+        channel->erase(channel->begin(), channel->begin() + begin);
+    }
 }
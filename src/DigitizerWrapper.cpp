@@ -7,6 +7,9 @@
 
 #include <CAENDigitizer.h>
 
+#include <chrono>
+#include <cmath>
+
 
 // constructor
 
@@ -14,12 +17,14 @@ DigitizerWrapper::DigitizerWrapper(
     std::shared_ptr<CollectorConfig> cc,
     std::shared_ptr<DigitizerConfig> dc,
     ErrorHandler *err,
-    std::shared_ptr<TimeTagHandler> tth
+    std::shared_ptr<TimeTagHandler> tth,
+    TaskScheduler *ts
 )
   : CC(cc), 
     DC(dc),
     ERR(err),
-    TTH(tth)
+    TTH(tth),
+    TS(ts)
 {}
 
 bool DigitizerWrapper::applyConfig() {
@@ -99,6 +104,7 @@ bool DigitizerWrapper::applyConfig() {
         // set trigger threshold for channel (e.g. ~18 mV)
         ret = CAEN_DGTZ_SetChannelTriggerThreshold(handle, channel, DC->triggerThreshold[channel]);
         if (ERR->CheckError(ret, "CAEN_DGTZ_SetChannelTriggerThreshold")) return false;
+        appliedThreshold[channel].store(DC->triggerThreshold[channel]);
 
         // set DC offset for channel
         ret = CAEN_DGTZ_SetChannelDCOffset(handle, channel, DC->dcOffset[channel]);
@@ -173,6 +179,13 @@ bool DigitizerWrapper::startCollecting(){
     // set status
     isCollecting.store(true);
 
+    // discard requests of a previous run
+    for (auto& threshold : pendingThreshold) threshold.store(-1);
+
+    // empty queue with configured size
+    q.configure(static_cast<size_t>(std::max(CC->digitizerQueueCapacity, 2)), CC->digitizerQueuePolicy);
+    q.reopen();
+
     // start data acquisition
     ret = CAEN_DGTZ_SWStartAcquisition(handle);
     if (ERR->CheckError(ret, "CAEN_DGTZ_SWStartAcquisition")) return false;
@@ -180,8 +193,13 @@ bool DigitizerWrapper::startCollecting(){
     // update start time (for absolute time stamps)
     TTH->setStartTime();
 
-    // start collection loop
-    collectDigitizerData = std::thread(&DigitizerWrapper::collectingLoop, this);
+    // start periodic readout (stops itself on error)
+    loopCount = 0;
+    nextEventID = 0;
+    auto interval = std::chrono::nanoseconds(static_cast<int64_t>(std::max(CC->readoutInterval, 0.001) * 1e9));
+    readoutTimer.store(TS->schedule(TaskPriority::Readout, interval, interval, [this]() {
+        if (!readout()) TS->cancel(readoutTimer.load());
+    }));
 
     return true;
 }
@@ -199,110 +217,315 @@ bool DigitizerWrapper::stopCollecting(){
         // stop is triggered by setting flag isCollecting to false
         isCollecting.store(false);
 
-        // wait collectingLoop to end
-        if (collectDigitizerData.joinable()) {
-            collectDigitizerData.join();
-        }
+        // release a blocked push
+        q.close();
+
+        // remove readout and wait for a running readout to end
+        TS->cancel(readoutTimer.exchange(0));
+
+        // free readout buffer
+        ret = CAEN_DGTZ_FreeReadoutBuffer(&buffer);
+        ERR->CheckError(ret, "CAEN_DGTZ_FreeReadoutBuffer");
+
+        // report queue statistics
+        ERR->logInfo(
+            "DigitizerWrapper::stopCollecting: queue high-water mark " + std::to_string(q.getHighWaterMark()) +
+            " of " + std::to_string(q.getCapacity()) +
+            ", dropped " + std::to_string(q.getDropped())
+        );
     }
 
     return true;
 }
 
-void DigitizerWrapper::collectingLoop() {
+void DigitizerWrapper::requestTriggerThreshold(int channel, uint16_t threshold) {
+
+    // check
+    if (channel < 0 || channel > 2) return;
+
+    // applied before the next readout
+    pendingThreshold[channel].store(threshold);
+}
+
+bool DigitizerWrapper::applyPendingThresholds() {
 
-    uint64_t loopCount = 0;
-    uint64_t eventID = 0;
+    for (int channel = 0; channel <= 2; channel++) {
 
-    // reading events in a loop
-    while (isCollecting.load()) {
+        // get and reset request
+        int threshold = pendingThreshold[channel].exchange(-1);
+        if (threshold < 0) continue;
+
+        // set trigger threshold for channel
+        ret = CAEN_DGTZ_SetChannelTriggerThreshold(handle, channel, static_cast<uint32_t>(threshold));
+        if (ERR->CheckError(ret, "CAEN_DGTZ_SetChannelTriggerThreshold")) return false;
 
         // report
-        if (CC->detailedLog) {
-            ERR->logInfo("DigitizerWrapper::collectingLoop: loopCount: " + std::to_string(loopCount));
+        ERR->logInfo(
+            "DigitizerWrapper::applyPendingThresholds: channel " + std::to_string(channel) +
+            ": triggerThreshold " + std::to_string(appliedThreshold[channel].load()) +
+            " -> " + std::to_string(threshold) +
+            " at " + std::to_string(TTH->getTimeStamp()) + " ns"
+        );
+
+        // the config is not changed
+        appliedThreshold[channel].store(static_cast<uint16_t>(threshold));
+    }
+
+    return true;
+}
+
+std::array<uint16_t,3> DigitizerWrapper::getTriggerThresholds() {
+    return {appliedThreshold[0].load(), appliedThreshold[1].load(), appliedThreshold[2].load()};
+}
+
+
+// calibration steps
+
+uint32_t DigitizerWrapper::activeChannelMask() {
+    return (DC->active[0] ? 1u : 0u) | (DC->active[1] ? 2u : 0u) | (DC->active[2] ? 4u : 0u);
+}
+
+bool DigitizerWrapper::setChannelDCOffset(int channel, uint16_t dcOffset) {
+
+    // set DC offset for channel
+    ret = CAEN_DGTZ_SetChannelDCOffset(handle, channel, dcOffset);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_SetChannelDCOffset")) return false;
+
+    // wait for the DAC to settle
+    usleep(100000);
+
+    return true;
+}
+
+bool DigitizerWrapper::setChannelTriggerThreshold(int channel, uint16_t threshold) {
+
+    // set trigger threshold for channel
+    ret = CAEN_DGTZ_SetChannelTriggerThreshold(handle, channel, threshold);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_SetChannelTriggerThreshold")) return false;
+    appliedThreshold[channel].store(threshold);
+
+    return true;
+}
+
+bool DigitizerWrapper::measureBaseline(int channel, int nTriggers, double& mean, double& rms) {
+
+    // only software triggers
+    ret = CAEN_DGTZ_SetChannelSelfTrigger(handle, CAEN_DGTZ_TRGMODE_DISABLED, 0x7);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_SetChannelSelfTrigger")) return false;
+
+    ret = CAEN_DGTZ_SetSWTriggerMode(handle, CAEN_DGTZ_TRGMODE_ACQ_ONLY);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_SetSWTriggerMode")) return false;
+
+    // record events
+    ret = CAEN_DGTZ_SWStartAcquisition(handle);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_SWStartAcquisition")) return false;
+
+    for (int i = 0; i < nTriggers; i++) {
+        ret = CAEN_DGTZ_SendSWtrigger(handle);
+        if (ERR->CheckError(ret, "CAEN_DGTZ_SendSWtrigger")) break;
+        usleep(1000);
+    }
+    usleep(10000);
+
+    uint32_t aktuelleBufferSize = 0;
+    ret = CAEN_DGTZ_ReadData(handle, CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, buffer, &aktuelleBufferSize);
+    ERR->CheckError(ret, "CAEN_DGTZ_ReadData");
+
+    CAEN_DGTZ_ErrorCode stopRet = CAEN_DGTZ_SWStopAcquisition(handle);
+    ERR->CheckError(stopRet, "CAEN_DGTZ_SWStopAcquisition");
+
+    // restore trigger settings
+    CAEN_DGTZ_ErrorCode modeRet = CAEN_DGTZ_SetSWTriggerMode(handle, CAEN_DGTZ_TRGMODE_DISABLED);
+    ERR->CheckError(modeRet, "CAEN_DGTZ_SetSWTriggerMode");
+
+    CAEN_DGTZ_ErrorCode selfRet = CAEN_DGTZ_SetChannelSelfTrigger(handle, CAEN_DGTZ_TRGMODE_ACQ_ONLY, activeChannelMask());
+    ERR->CheckError(selfRet, "CAEN_DGTZ_SetChannelSelfTrigger");
+
+    if (ret != CAEN_DGTZ_Success || stopRet != CAEN_DGTZ_Success) return false;
+
+    // sum samples of the channel
+    uint32_t numEvents = 0;
+    ret = CAEN_DGTZ_GetNumEvents(handle, buffer, aktuelleBufferSize, &numEvents);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_GetNumEvents")) return false;
+
+    double sum = 0, sum2 = 0;
+    uint64_t n = 0;
+
+    CAEN_DGTZ_EventInfo_t eventInfo{};
+    char* eventPtr = nullptr;
+    void* decodedEvent = nullptr;
+
+    for (uint32_t index = 0; index < numEvents; index++) {
+        ret = CAEN_DGTZ_GetEventInfo(handle, buffer, aktuelleBufferSize, index, &eventInfo, &eventPtr);
+        if (ERR->CheckError(ret, "CAEN_DGTZ_GetEventInfo")) return false;
+
+        ret = CAEN_DGTZ_DecodeEvent(handle, eventPtr, &decodedEvent);
+        if (ERR->CheckError(ret, "CAEN_DGTZ_DecodeEvent")) return false;
+
+        CAEN_DGTZ_UINT16_EVENT_t* event = (CAEN_DGTZ_UINT16_EVENT_t*)decodedEvent;
+        for (uint32_t i = 0; i < event->ChSize[channel]; i++) {
+            double sample = event->DataChannel[channel][i];
+            sum += sample;
+            sum2 += sample * sample;
         }
+        n += event->ChSize[channel];
+
+        ret = CAEN_DGTZ_FreeEvent(handle, &decodedEvent);
+        if (ERR->CheckError(ret, "CAEN_DGTZ_FreeEvent")) return false;
+    }
+
+    // check
+    if (n == 0) {
+        ERR->ThrowError("DigitizerWrapper::measureBaseline: no samples recorded");
+        return false;
+    }
+
+    mean = sum / n;
+    rms = std::sqrt(std::max(sum2 / n - mean * mean, 0.0));
+
+    return true;
+}
+
+bool DigitizerWrapper::countTriggers(int channel, double seconds, uint64_t& triggers, double& liveTime) {
+
+    // self trigger of this channel only
+    ret = CAEN_DGTZ_SetChannelSelfTrigger(handle, CAEN_DGTZ_TRGMODE_DISABLED, 0x7);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_SetChannelSelfTrigger")) return false;
+
+    ret = CAEN_DGTZ_SetChannelSelfTrigger(handle, CAEN_DGTZ_TRGMODE_ACQ_ONLY, 1u << channel);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_SetChannelSelfTrigger")) return false;
+
+    // majority level 0, so that a single channel triggers
+    uint32_t reg, oldReg;
+    ret = CAEN_DGTZ_ReadRegister(handle, 0x810C, &oldReg);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_ReadRegister")) return false;
+    reg = oldReg & ~(0x7 << 24);
+    ret = CAEN_DGTZ_WriteRegister(handle, 0x810C, reg);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_WriteRegister")) return false;
+
+    // count events
+    triggers = 0;
+
+    ret = CAEN_DGTZ_SWStartAcquisition(handle);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_SWStartAcquisition")) return false;
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
 
-        // wait for events
-        usleep(100000); // wait 100 ms
+    bool ok = true;
+    while (ok && elapsed() < seconds) {
+        usleep(10000);
 
-        // check if data is in buffer
         uint32_t aktuelleBufferSize = 0;
         ret = CAEN_DGTZ_ReadData(handle, CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, buffer, &aktuelleBufferSize);
-        if (ERR->CheckError(ret, "CAEN_DGTZ_ReadData")) return;
+        if (ERR->CheckError(ret, "CAEN_DGTZ_ReadData")) { ok = false; break; }
 
         if (aktuelleBufferSize > 0) {
             uint32_t numEvents = 0;
             ret = CAEN_DGTZ_GetNumEvents(handle, buffer, aktuelleBufferSize, &numEvents);
-            if (ERR->CheckError(ret, "CAEN_DGTZ_GetNumEvents")) return;
-
-            // report
-            ERR->logInfo("Digitizer: loopCount: " + std::to_string(loopCount) + ": " + std::to_string(numEvents) + " event(s) recognized");
-
-            if (numEvents > 0) {
-
-                CAEN_DGTZ_EventInfo_t eventInfo{};
-                char* eventPtr = nullptr;
-                void* decodedEvent = nullptr;
-
-                // write every event in ttree
-                for(int index=0; index<numEvents; index++){
-
-                    // report
-                    if (CC->detailedLog) {
-                        ERR->logInfo("DigitizerWrapper::collectingLoop: eventID: " + std::to_string(eventID));
-                    }
-                    
-                    // get EventInfo and EventPointer
-                    ret = CAEN_DGTZ_GetEventInfo(handle, buffer, aktuelleBufferSize, index, &eventInfo, &eventPtr);
-                    if (ERR->CheckError(ret, "CAEN_DGTZ_GetEventInfo")) return;
-
-                    // decode event
-                    ret = CAEN_DGTZ_DecodeEvent(handle, eventPtr, &decodedEvent);
-                    if (ERR->CheckError(ret, "CAEN_DGTZ_DecodeEvent")) return;
-
-                    // cast to correct type
-                    evt = (CAEN_DGTZ_UINT16_EVENT_t*)decodedEvent;
-                    
-                    // initialize vectors with data
-                    std::vector<Double_t> v0(evt->ChSize[0]), v1(evt->ChSize[1]), v2(evt->ChSize[2]);
-
-                    // lambda function that copies data from ADC samples to the data vector
-                    auto fillChannel = [](std::vector<Double_t>& dst, const uint16_t* src, uint32_t size) {
-                        std::transform(src, src + size, dst.begin(),
-                                    [](uint16_t x) { return static_cast<Double_t>(x); });
-                    };
-
-                    // fill vectors with dataevt->ChSize[2]
-                    if (DC->active[0]) fillChannel(v0, evt->DataChannel[0], evt->ChSize[0]);
-                    if (DC->active[1]) fillChannel(v1, evt->DataChannel[1], evt->ChSize[1]);
-                    if (DC->active[2]) fillChannel(v2, evt->DataChannel[2], evt->ChSize[2]);
-
-                    // clean event from buffer
-                    ret = CAEN_DGTZ_FreeEvent(handle, &decodedEvent);
-                    if (ERR->CheckError(ret, "CAEN_DGTZ_FreeEvent")) return;
-
-                    // get time event
-                    uint32_t ttt = eventInfo.TriggerTimeTag;
-                    
-                    // devode event time in absolute time in ns since 1970
-                    Long64_t ts = static_cast<Long64_t>(TTH->decode(ttt));
-
-                    // sumarize data
-                    DigitizerData DGEvt = DigitizerData(eventID, ts, v0, v1, v2);
-
-                    // add event to queue
-                    q.push(std::move(DGEvt));
-
-                    // increase eventID
-                    eventID++;
+            if (ERR->CheckError(ret, "CAEN_DGTZ_GetNumEvents")) { ok = false; break; }
+            triggers += numEvents;
+        }
+    }
+
+    liveTime = elapsed();
+
+    ret = CAEN_DGTZ_SWStopAcquisition(handle);
+    ERR->CheckError(ret, "CAEN_DGTZ_SWStopAcquisition");
+
+    // restore majority level and self trigger
+    ret = CAEN_DGTZ_WriteRegister(handle, 0x810C, oldReg);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_WriteRegister")) return false;
+
+    ret = CAEN_DGTZ_SetChannelSelfTrigger(handle, CAEN_DGTZ_TRGMODE_ACQ_ONLY, activeChannelMask());
+    if (ERR->CheckError(ret, "CAEN_DGTZ_SetChannelSelfTrigger")) return false;
+
+    return ok;
+}
+
+bool DigitizerWrapper::readout() {
+
+    // report
+    if (CC->detailedLog) {
+        ERR->logInfo("DigitizerWrapper::readout: loopCount: " + std::to_string(loopCount));
+    }
+
+    // change thresholds between readout blocks
+    if (!applyPendingThresholds()) return false;
+
+    // check if data is in buffer
+    uint32_t aktuelleBufferSize = 0;
+    ret = CAEN_DGTZ_ReadData(handle, CAEN_DGTZ_SLAVE_TERMINATED_READOUT_MBLT, buffer, &aktuelleBufferSize);
+    if (ERR->CheckError(ret, "CAEN_DGTZ_ReadData")) return false;
+
+    if (aktuelleBufferSize > 0) {
+        uint32_t numEvents = 0;
+        ret = CAEN_DGTZ_GetNumEvents(handle, buffer, aktuelleBufferSize, &numEvents);
+        if (ERR->CheckError(ret, "CAEN_DGTZ_GetNumEvents")) return false;
+
+        // report
+        ERR->logInfo("Digitizer: loopCount: " + std::to_string(loopCount) + ": " + std::to_string(numEvents) + " event(s) recognized");
+
+        if (numEvents > 0) {
+
+            CAEN_DGTZ_EventInfo_t eventInfo{};
+            char* eventPtr = nullptr;
+            void* decodedEvent = nullptr;
+
+            // write every event in ttree
+            for(int index=0; index<numEvents; index++){
+
+                // report
+                if (CC->detailedLog) {
+                    ERR->logInfo("DigitizerWrapper::readout: eventID: " + std::to_string(nextEventID));
                 }
+                
+                // get EventInfo and EventPointer
+                ret = CAEN_DGTZ_GetEventInfo(handle, buffer, aktuelleBufferSize, index, &eventInfo, &eventPtr);
+                if (ERR->CheckError(ret, "CAEN_DGTZ_GetEventInfo")) return false;
+
+                // decode event
+                ret = CAEN_DGTZ_DecodeEvent(handle, eventPtr, &decodedEvent);
+                if (ERR->CheckError(ret, "CAEN_DGTZ_DecodeEvent")) return false;
+
+                // cast to correct type
+                evt = (CAEN_DGTZ_UINT16_EVENT_t*)decodedEvent;
+                
+                // copy raw ADC samples of the active channels
+                auto copyChannel = [&](int channel) {
+                    if (!DC->active[channel]) return std::vector<UShort_t>();
+                    const uint16_t* src = evt->DataChannel[channel];
+                    return std::vector<UShort_t>(src, src + evt->ChSize[channel]);
+                };
+
+                std::vector<UShort_t> v0 = copyChannel(0), v1 = copyChannel(1), v2 = copyChannel(2);
+
+                // clean event from buffer
+                ret = CAEN_DGTZ_FreeEvent(handle, &decodedEvent);
+                if (ERR->CheckError(ret, "CAEN_DGTZ_FreeEvent")) return false;
+
+                // get time event
+                uint32_t ttt = eventInfo.TriggerTimeTag;
+                
+                // devode event time in absolute time in ns since 1970
+                Long64_t ts = static_cast<Long64_t>(TTH->decode(ttt));
+
+                // sumarize data
+                DigitizerData DGEvt = DigitizerData(nextEventID, ts, std::move(v0), std::move(v1), std::move(v2));
+
+                // add event to queue
+                q.push(std::move(DGEvt));
+
+                // increase eventID
+                nextEventID++;
             }
         }
-
-        // increase loopCount
-        loopCount++;
     }
 
-    // free readout buffer
-    ret = CAEN_DGTZ_FreeReadoutBuffer(&buffer);
-    ERR->CheckError(ret, "CAEN_DGTZ_FreeReadoutBuffer");
+    // increase loopCount
+    loopCount++;
+
+    return true;
 }
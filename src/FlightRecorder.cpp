@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <ctime>
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include <FlightRecorder.h>
+#include <RootTreeWriter.h>
+#include <CollectorConfig.h>
+#include <ErrorHandler.h>
+
+namespace fs = std::filesystem;
+
+
+// constructor and destructor
+
+FlightRecorder::FlightRecorder(
+    std::shared_ptr<CollectorConfig> cc,
+    ErrorHandler *err,
+    TaskScheduler *ts
+) : CC(cc),
+    TS(ts),
+    ERR(err)
+{}
+
+FlightRecorder::~FlightRecorder() {
+    joinDump();
+}
+
+
+// ring buffer
+
+void FlightRecorder::addEvent(const DigitizerData& DData) {
+
+    // window length in ns
+    Long64_t window = static_cast<Long64_t>(CC->flightRecorderSeconds) * 1000000000LL;
+
+    // drop events that are older than the window or exceed the limit
+    while (!buffer.empty() && (
+        DData.eventTime - buffer.front().eventTime > window ||
+        buffer.size() >= static_cast<size_t>(CC->flightRecorderMaxEvents)
+    )) {
+        bufferBytes -= eventBytes(buffer.front());
+        buffer.pop_front();
+    }
+
+    // add copy of the event
+    if (CC->flightRecorderMaxEvents > 0) {
+        buffer.push_back(DData);
+        bufferBytes += eventBytes(buffer.back());
+    }
+}
+
+void FlightRecorder::clear() {
+    buffer.clear();
+    bufferBytes = 0;
+    dumpRequested.store(false);
+}
+
+size_t FlightRecorder::eventBytes(const DigitizerData& DData) {
+    return sizeof(DigitizerData) + (DData.ch0.capacity() + DData.ch1.capacity() + DData.ch2.capacity()) * sizeof(UShort_t);
+}
+
+
+// dump handling
+
+void FlightRecorder::requestDump(std::string const reason) {
+
+    // lock block for threadsafe
+    std::lock_guard<std::mutex> lock(mtx);
+
+    // report
+    ERR->logInfo("FlightRecorder::requestDump: " + reason);
+
+    // set request
+    dumpReason = reason;
+    dumpRequested.store(true);
+}
+
+bool FlightRecorder::checkDump() {
+
+    // nothing to do
+    if (!dumpRequested.load()) return false;
+
+    // keep request till previous dump is written
+    if (dumpRunning.load()) return false;
+
+    // get reason
+    std::string reason;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        reason = dumpReason;
+        dumpRequested.store(false);
+    }
+
+    // check
+    if (buffer.empty()) {
+        ERR->logInfo("FlightRecorder::checkDump: buffer is empty, nothing to dump");
+        return false;
+    }
+
+    // take the window out of the ring buffer (no copy of waveforms)
+    std::vector<DigitizerData> events(
+        std::make_move_iterator(buffer.begin()),
+        std::make_move_iterator(buffer.end())
+    );
+    buffer.clear();
+    bufferBytes = 0;
+
+    // write in background
+    joinDump();
+    dumpRunning.store(true);
+    dump = TS->submit(TaskPriority::Writing, [this, events = std::move(events), reason]() mutable {
+        writeDump(std::move(events), reason);
+    });
+
+    return true;
+}
+
+void FlightRecorder::writeDump(std::vector<DigitizerData> events, std::string reason) {
+
+    // get file path from time of the first event
+    std::time_t t = static_cast<std::time_t>(events.front().eventTime / 1000000000LL);
+    std::tm tm{};
+    gmtime_r(&t, &tm);
+
+    char buf[32];
+    std::strftime(buf, sizeof(buf), "%Y_%m_%d", &tm);
+    std::string folderName = buf;
+    std::strftime(buf, sizeof(buf), "%Y_%m_%d_%H_%M_%S", &tm);
+    std::string fileName = static_cast<std::string>(buf);
+
+    // milliseconds and number of the dump (several dumps in one second)
+    std::snprintf(buf, sizeof(buf), "_%03d_%04d", static_cast<int>(events.front().eventTime / 1000000 % 1000), dumpCount++);
+    fileName += static_cast<std::string>(buf) + "_" + reason + "_flightrecorder.root";
+
+    fs::path filePath = fs::path(CC->workingDir) / folderName / fileName;
+
+    // report
+    ERR->logInfo("FlightRecorder::writeDump: " + std::to_string(events.size()) + " event(s) to " + filePath.string());
+
+    // create folder if it doesnt exist
+    fs::create_directories(filePath.parent_path());
+
+    // open file and check
+    TFile file(filePath.c_str(), "RECREATE", "", RootTreeWriter::compressionSettings(*CC));
+    if (file.IsZombie()) {
+        ERR->ThrowError("FlightRecorder::writeDump: error when opening " + filePath.string());
+        dumpRunning.store(false);
+        return;
+    }
+
+    // buffers for the longest waveform
+    size_t maxSamples = 1;
+    for (const DigitizerData& DData : events) {
+        maxSamples = std::max({maxSamples, DData.ch0.size(), DData.ch1.size(), DData.ch2.size()});
+    }
+
+    // same layout as data1
+    Long64_t ts_data1;
+    Int_t ns[3];
+    std::vector<UShort_t> ch[3];
+    for (auto& samples : ch) samples.assign(maxSamples, 0);
+
+    TTree *data1 = new TTree("data1", "Digitizer Data (flight recorder)");
+    data1->Branch("ts_data1", &ts_data1, "ts_data1/L");
+    for (int channel = 0; channel <= 2; channel++) {
+        std::string n = "ns" + std::to_string(channel);
+        std::string c = "ch" + std::to_string(channel);
+        data1->Branch(n.c_str(), &ns[channel], (n + "/I").c_str());
+        data1->Branch(c.c_str(), ch[channel].data(), (c + "[" + n + "]/s").c_str());
+    }
+
+    // fill events
+    for (const DigitizerData& DData : events) {
+        ts_data1 = DData.eventTime;
+        const std::vector<UShort_t>* samples[3] = {&DData.ch0, &DData.ch1, &DData.ch2};
+        for (int channel = 0; channel <= 2; channel++) {
+            ns[channel] = static_cast<Int_t>(samples[channel]->size());
+            std::copy(samples[channel]->begin(), samples[channel]->end(), ch[channel].begin());
+        }
+        data1->Fill();
+    }
+
+    // write and close (will also delete the TTree)
+    data1->Write();
+    file.Close();
+
+    // status
+    dumpRunning.store(false);
+}
+
+void FlightRecorder::joinDump() {
+
+    // wait till dump is written
+    if (dump.valid()) dump.wait();
+}
@@ -0,0 +1,108 @@
+#include <string>
+#include <stdexcept>
+
+#include <ROOT/RNTupleWriteOptions.hxx>
+
+#include <NTupleOutput.h>
+
+
+// destructor
+
+NTupleOutput::~NTupleOutput() {
+    close();
+}
+
+
+// file handling
+
+void NTupleOutput::open(TFile* file, int compression) {
+
+    // check
+    if (!file) throw std::runtime_error("NTupleOutput::open: No File open");
+
+    ROOT::RNTupleWriteOptions options;
+    options.SetCompression(compression);
+
+    // digitizer events with waveforms of variable length
+    auto model1 = ROOT::RNTupleModel::Create();
+    ts_data1 = model1->MakeField<Long64_t>("ts_data1");
+    eventID = model1->MakeField<ULong64_t>("eventID");
+    for (int channel = 0; channel <= 2; channel++) {
+        waveform[channel] = model1->MakeField<std::vector<std::uint16_t>>("ch" + std::to_string(channel));
+    }
+    data1 = ROOT::RNTupleWriter::Append(std::move(model1), "data1", *file, options);
+
+    // rate and pressure
+    auto model2 = ROOT::RNTupleModel::Create();
+    ts_data2 = model2->MakeField<Long64_t>("ts_data2");
+    rate = model2->MakeField<Double_t>("rate");
+    pressure = model2->MakeField<Double_t>("pressure");
+    data2 = ROOT::RNTupleWriter::Append(std::move(model2), "data2", *file, options);
+
+    // tank sensors
+    static const char* tancaNames[8] = {
+        "tanca_h1", "tanca_t1", "tanca_h2", "tanca_t2",
+        "tanca_h3", "tanca_t3", "tanca_h4", "tanca_t4"
+    };
+    auto model3 = ROOT::RNTupleModel::Create();
+    ts_data3 = model3->MakeField<Long64_t>("ts_data3");
+    for (size_t i = 0; i < tanca.size(); i++) {
+        tanca[i] = model3->MakeField<Double_t>(tancaNames[i]);
+    }
+    data3 = ROOT::RNTupleWriter::Append(std::move(model3), "data3", *file, options);
+
+    data2Entries = 0;
+}
+
+void NTupleOutput::close() {
+
+    // destroying the writers commits the last cluster and the footer
+    data1.reset();
+    data2.reset();
+    data3.reset();
+}
+
+void NTupleOutput::commitCluster() {
+    for (auto* writer : {data1.get(), data2.get(), data3.get()}) {
+        if (writer) writer->CommitCluster();
+    }
+}
+
+
+// add events
+
+Long64_t NTupleOutput::fillData1(const DigitizerData& DData) {
+    *ts_data1 = DData.eventTime;
+    *eventID = DData.eventID;
+
+    const std::vector<UShort_t>* samples[3] = {&DData.ch0, &DData.ch1, &DData.ch2};
+    Long64_t bytes = sizeof(Long64_t) + sizeof(ULong64_t);
+    for (int channel = 0; channel <= 2; channel++) {
+        waveform[channel]->assign(samples[channel]->begin(), samples[channel]->end());
+        bytes += samples[channel]->size() * sizeof(std::uint16_t);
+    }
+
+    data1->Fill();
+
+    return bytes;
+}
+
+Long64_t NTupleOutput::fillData2(Long64_t ts_data2_, Double_t rate_, Double_t pressure_) {
+    *ts_data2 = ts_data2_;
+    *rate = rate_;
+    *pressure = pressure_;
+
+    data2->Fill();
+    data2Entries++;
+
+    return sizeof(Long64_t) + 2 * sizeof(Double_t);
+}
+
+Long64_t NTupleOutput::fillData3(Long64_t ts_data3_, const std::array<Double_t, 8>& tanca_) {
+    *ts_data3 = ts_data3_;
+    for (size_t i = 0; i < tanca.size(); i++) *tanca[i] = tanca_[i];
+
+    data3->Fill();
+
+    return sizeof(Long64_t) + tanca.size() * sizeof(Double_t);
+}
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <RawLogWriter.h>
+#include <CollectorConfig.h>
+#include <ErrorHandler.h>
+
+
+// constructor and destructor
+
+RawLogWriter::RawLogWriter(
+    std::shared_ptr<CollectorConfig> cc,
+    ErrorHandler *err,
+    TaskScheduler *ts
+) : CC(cc),
+    TS(ts),
+    ERR(err)
+{}
+
+RawLogWriter::~RawLogWriter() {
+    close();
+    for (Buffer& buffer : buffers) std::free(buffer.data);
+}
+
+
+// file handling
+
+bool RawLogWriter::open(const fs::path& basePath_) {
+
+    // report
+    ERR->logInfo("RawLogWriter::open: " + basePath_.string());
+
+    // check
+    if (fd >= 0) {
+        ERR->ThrowError("RawLogWriter::open: Segment is already open");
+        return false;
+    }
+
+    // aligned buffers with room for the padding record
+    if (!buffers[0].data) {
+        size_t blocks = (static_cast<size_t>(std::max(CC->rawBufferMB, 1)) * 1048576 + rawLogAlignment - 1) / rawLogAlignment;
+        capacity = blocks * rawLogAlignment;
+        for (Buffer& buffer : buffers) {
+            buffer.data = static_cast<char*>(std::aligned_alloc(rawLogAlignment, capacity + 2 * rawLogAlignment));
+            if (!buffer.data) {
+                ERR->ThrowError("RawLogWriter::open: cannot allocate buffers");
+                return false;
+            }
+        }
+    }
+
+    basePath = basePath_;
+    segments.clear();
+    arduinoRecords = 0;
+    writeFailed = false;
+    current = 0;
+    buffers[0].used = 0;
+    buffers[1].used = 0;
+
+    return openSegment();
+}
+
+bool RawLogWriter::close() {
+
+    // check
+    if (fd < 0) return true;
+
+    // report
+    ERR->logInfo("RawLogWriter::close: " + std::to_string(segments.size()) + " segment(s)");
+
+    submitBuffer();
+    waitWrite();
+    closeSegment();
+
+    return !writeFailed.load();
+}
+
+bool RawLogWriter::openSegment() {
+
+    // next segment name
+    char suffix[16];
+    std::snprintf(suffix, sizeof(suffix), "_%03zu.raw", segments.size());
+    fs::path path = basePath.string() + suffix;
+
+    // bypass page cache if requested (not supported by every file system)
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    if (CC->rawDirectIO) {
+        fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        if (fd < 0 && errno == EINVAL) {
+            ERR->logInfo("RawLogWriter::openSegment: O_DIRECT not supported, using buffered writes");
+        }
+    }
+    if (fd < 0) fd = ::open(path.c_str(), flags, 0644);
+    if (fd < 0) {
+        ERR->ThrowError("RawLogWriter::openSegment: cannot open " + path.string() + ": " + std::strerror(errno));
+        return false;
+    }
+
+    segments.push_back(path);
+    segmentBytes = 0;
+
+    // segment header at the start of the (empty) current buffer
+    RawSegmentHeader header{};
+    std::memcpy(header.magic, rawLogMagic, sizeof(rawLogMagic));
+    header.version = rawLogVersion;
+    header.headerSize = sizeof(RawSegmentHeader);
+    header.created = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    header.sequence = segments.size() - 1;
+
+    Buffer& buffer = buffers[current];
+    std::memcpy(buffer.data + buffer.used, &header, sizeof(header));
+    buffer.used += sizeof(header);
+
+    return true;
+}
+
+void RawLogWriter::closeSegment() {
+    if (fd < 0) return;
+    if (::close(fd) != 0) {
+        ERR->ThrowError("RawLogWriter::closeSegment: " + std::string(std::strerror(errno)));
+        writeFailed = true;
+    }
+    fd = -1;
+}
+
+
+// add events
+
+char* RawLogWriter::reserve(size_t size) {
+
+    // check
+    if (fd < 0) return nullptr;
+    if (size > capacity - sizeof(RawSegmentHeader)) {
+        ERR->ThrowError("RawLogWriter: record of " + std::to_string(size) + " bytes exceeds the buffer");
+        return nullptr;
+    }
+
+    // full buffer goes to disk
+    if (buffers[current].used + size > capacity) submitBuffer();
+
+    Buffer& buffer = buffers[current];
+    char* record = buffer.data + buffer.used;
+    buffer.used += size;
+
+    // zero the alignment bytes at the end
+    std::memset(record + size - 8, 0, 8);
+
+    return record;
+}
+
+size_t RawLogWriter::appendDigitizer(const DigitizerData& DData) {
+
+    const std::vector<UShort_t>* channels[3] = {&DData.ch0, &DData.ch1, &DData.ch2};
+    size_t samples = DData.ch0.size() + DData.ch1.size() + DData.ch2.size();
+
+    // encode waveforms before the size is known
+    uint16_t flags = 0;
+    size_t payload = samples * sizeof(uint16_t);
+    if (CC->rawWaveformCodec) {
+        encoded.clear();
+        for (int channel = 0; channel <= 2; channel++) {
+            WaveformCodec::encode(channels[channel]->data(), channels[channel]->size(), encoded);
+        }
+        flags |= rawFlagWaveformCodec;
+        payload = encoded.size();
+    }
+    uint32_t size = rawRecordSize(sizeof(RawDigitizerRecord) + payload);
+
+    char* record = reserve(size);
+    if (!record) return 0;
+
+    RawRecordHeader header{size, RawDigitizer, flags, DData.eventTime};
+    std::memcpy(record, &header, sizeof(header));
+
+    RawDigitizerRecord digitizer{};
+    digitizer.eventID = DData.eventID;
+    for (int channel = 0; channel <= 2; channel++) {
+        digitizer.nSamples[channel] = static_cast<uint32_t>(channels[channel]->size());
+    }
+    std::memcpy(record + sizeof(header), &digitizer, sizeof(digitizer));
+
+    // samples of all channels one after another
+    char* out = record + sizeof(header) + sizeof(digitizer);
+    if (flags & rawFlagWaveformCodec) {
+        std::memcpy(out, encoded.data(), encoded.size());
+        return size;
+    }
+    for (int channel = 0; channel <= 2; channel++) {
+        size_t bytes = channels[channel]->size() * sizeof(uint16_t);
+        if (bytes) std::memcpy(out, channels[channel]->data(), bytes);
+        out += bytes;
+    }
+
+    return size;
+}
+
+size_t RawLogWriter::appendArduino(Long64_t time, Double_t rate, Double_t pressure) {
+
+    uint32_t size = rawRecordSize(sizeof(RawArduinoRecord));
+    char* record = reserve(size);
+    if (!record) return 0;
+
+    RawRecordHeader header{size, RawArduino, 0, time};
+    RawArduinoRecord arduino{rate, pressure};
+    std::memcpy(record, &header, sizeof(header));
+    std::memcpy(record + sizeof(header), &arduino, sizeof(arduino));
+    arduinoRecords++;
+
+    return size;
+}
+
+size_t RawLogWriter::appendTanca(Long64_t time, const std::array<Double_t, 8>& tanca) {
+
+    uint32_t size = rawRecordSize(sizeof(RawTancaRecord));
+    char* record = reserve(size);
+    if (!record) return 0;
+
+    RawRecordHeader header{size, RawTanca, 0, time};
+    RawTancaRecord values{};
+    std::copy(tanca.begin(), tanca.end(), values.tanca);
+    std::memcpy(record, &header, sizeof(header));
+    std::memcpy(record + sizeof(header), &values, sizeof(values));
+
+    return size;
+}
+
+
+// writing
+
+void RawLogWriter::flush() {
+    if (fd >= 0) submitBuffer();
+}
+
+void RawLogWriter::pad(Buffer& buffer) {
+
+    // padding record up to the next block (at least a record header)
+    size_t rest = buffer.used % rawLogAlignment;
+    if (rest == 0) return;
+    size_t padding = rawLogAlignment - rest;
+    if (padding < sizeof(RawRecordHeader)) padding += rawLogAlignment;
+
+    RawRecordHeader header{static_cast<uint32_t>(padding), RawPadding, 0, 0};
+    std::memset(buffer.data + buffer.used, 0, padding);
+    std::memcpy(buffer.data + buffer.used, &header, sizeof(header));
+    buffer.used += padding;
+}
+
+void RawLogWriter::submitBuffer() {
+
+    Buffer& buffer = buffers[current];
+    if (buffer.used == 0 || fd < 0) return;
+
+    // O_DIRECT writes whole blocks
+    if (CC->rawDirectIO) pad(buffer);
+
+    // other buffer is free again after its write
+    waitWrite();
+
+    int target = fd;
+    const char* data = buffer.data;
+    size_t size = buffer.used;
+    segmentBytes += size;
+    pendingWrite = TS->submit(TaskPriority::Writing, [this, target, data, size]() { writeAll(target, data, size); });
+
+    // switch buffer
+    current ^= 1;
+    buffers[current].used = 0;
+
+    // next segment
+    if (segmentBytes >= static_cast<size_t>(std::max(CC->rawSegmentMB, 1)) * 1048576) {
+        waitWrite();
+        closeSegment();
+        openSegment();
+    }
+}
+
+void RawLogWriter::waitWrite() {
+    if (pendingWrite.valid()) pendingWrite.wait();
+    pendingWrite = TaskFuture();
+}
+
+void RawLogWriter::writeAll(int target, const char* data, size_t size) {
+
+    // write till all bytes are on disk
+    while (size > 0) {
+        ssize_t written = ::write(target, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            ERR->ThrowError("RawLogWriter: write failed: " + std::string(std::strerror(errno)));
+            writeFailed = true;
+            return;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
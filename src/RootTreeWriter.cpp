@@ -1,12 +1,18 @@
 #include <CAENDigitizer.h>
 #include <tuple>
+#include <cstdio>
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 #include <chrono>
 #include <filesystem>
-#include <thread>
+#include <limits>
+
+#include <Compression.h>
+#include <TROOT.h>
 
 #include <CollectorConfig.h>
+#include <DigitizerConfig.h>
 #include <DigitizerWrapper.h>
 #include <RootTreeWriter.h>
 
@@ -14,11 +20,40 @@
 
 RootTreeWriter::RootTreeWriter(
     std::shared_ptr<CollectorConfig> cc,
-    ErrorHandler *err
+    std::shared_ptr<DigitizerConfig> dc,
+    ErrorHandler *err,
+    TaskScheduler *ts
 ) : CC(cc),
+    DC(dc),
+    BE(cc, err, ts),
+    TS(ts),
     ERR(err)
 {}
 
+int RootTreeWriter::compressionSettings(const CollectorConfig& cc) {
+
+    using Algorithm = ROOT::RCompressionSetting::EAlgorithm;
+
+    Algorithm::EValues algorithm = Algorithm::kZSTD;
+    switch (cc.compressionAlgorithm) {
+        case CompressionAlgorithm::ZLIB: algorithm = Algorithm::kZLIB; break;
+        case CompressionAlgorithm::LZMA: algorithm = Algorithm::kLZMA; break;
+        case CompressionAlgorithm::LZ4:  algorithm = Algorithm::kLZ4;  break;
+        case CompressionAlgorithm::ZSTD: algorithm = Algorithm::kZSTD; break;
+    }
+
+    return ROOT::CompressionSettings(algorithm, std::clamp(cc.compressionLevel, 1, 9));
+}
+
+
+RootTreeWriter::~RootTreeWriter() {
+
+    // prepared file that was never used
+    discardPrepared();
+
+    joinFinalize();
+}
+
 
 // file handling
 
@@ -28,118 +63,678 @@ bool RootTreeWriter::openNewFile() {
     ERR->logInfo("RootTreeWriter::openNewFile");
 
     // check
-    if (file) {
+    if (current) {
         ERR->ThrowError("openNewFile: File is already open");
         return false;
     }
 
-    // set fileName, folderName and filePath
-    auto createFilePath = [=](std::string workingDir) {
-        // get time
-        auto t = std::time(nullptr);
-        std::tm tm{};
-        gmtime_r(&t, &tm);
+    configureImplicitMT();
 
-        char buf[32];
+    // copies of the last run and files left open by a crash
+    if (CC->enableBackup) BE.start();
+    if (!recoveryStarted) {
+        recoverFiles();
+        recoveryStarted = true;
+    }
+
+    // partitions of the rotation period by event time
+    partitionPeriod = CC->partitionByEventTime ? static_cast<Long64_t>(CC->rotationPeriod * 1e9) : 0;
+    if (CC->partitionByEventTime && partitionPeriod <= 0) {
+        ERR->logInfo("RootTreeWriter::openNewFile: partitionByEventTime needs a rotationPeriod, writing one file");
+    }
 
-        // get file name
-        std::strftime(buf, sizeof(buf), "%Y_%m_%d_%H", &tm);
-        fileName = static_cast<std::string>(buf) + "_tanca.root";
+    // file starting now (or partition of now)
+    Long64_t now = static_cast<Long64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    unflushedBytes = 0;
+    if (partitionPeriod > 0) return openPartition(slotOf(now)) != nullptr;
 
-        // get folder name
-        std::strftime(buf, sizeof(buf), "%Y_%m_%d", &tm);
-        folderName = static_cast<std::string>(buf);
+    current = createFile(now);
 
-        // get total file path
-        filePath = fs::path(workingDir) / folderName / fileName;
-    };
+    return current != nullptr;
+}
 
-    // set variables of backup
-    createFilePath(CC->workingDir);
+void RootTreeWriter::prepareNextFile(Long64_t start) {
 
-    // create folder if it doesnt exist
-    fs::create_directories(filePath.parent_path());
+    // report
+    ERR->logInfo("RootTreeWriter::prepareNextFile");
 
-    // open new file and check
-    file = new TFile(filePath.c_str(), "RECREATE");
-    if (!file || file->IsZombie()) {
-        ERR->ThrowError("error when opening the ROOT current file");
+    // check
+    if (preparing.valid()) return;
+
+    // open file and define trees in a worker, the readout continues
+    nextStart = start;
+    preparing = TS->submit(TaskPriority::Writing, [this, start]() {
+        auto out = createFile(start);
+        std::lock_guard<std::mutex> lock(nextMtx);
+        next = std::move(out);
+    });
+}
+
+bool RootTreeWriter::rotateFile(Long64_t start) {
+
+    // report
+    ERR->logInfo("RootTreeWriter::rotateFile");
+
+    // check
+    if (!current) {
+        ERR->ThrowError("No File open");
+        return false;
+    }
+    if (partitionPeriod > 0) {
+        ERR->ThrowError("rotateFile: output is partitioned by event time");
         return false;
     }
 
-    // create new TTree
-    data1 = new TTree("data1", "Digitizer Data");
-    data2 = new TTree("data2", "Arduino Data 1");
-    data3 = new TTree("data3", "Arduino Data 2");
-
-    // define Branches
-    data1->Branch("ts_data1",   &ts_data1,   "ts_data1/L");
-    data1->Branch("ch0", &ch0);
-    data1->Branch("ch1", &ch1);
-    data1->Branch("ch2", &ch2);
-
-    data2->Branch("ts_data2",   &ts_data2,   "ts_data2/L");
-    data2->Branch("rate",       &rate,       "rate/D");
-    data2->Branch("pressure",   &pressure,   "pressure/D");
-
-    data3->Branch("ts_data3",   &ts_data3,   "ts_data3/L");
-    data3->Branch("tanca_h2",   &tanca_h2,   "tanca_h2/D");
-    data3->Branch("tanca_t1",   &tanca_t1,   "tanca_t1/D");
-    data3->Branch("tanca_h1",   &tanca_h1,   "tanca_h1/D");
-    data3->Branch("tanca_t2",   &tanca_t2,   "tanca_t2/D");
-    data3->Branch("tanca_t3",   &tanca_t3,   "tanca_t3/D");
-    data3->Branch("tanca_h3",   &tanca_h3,   "tanca_h3/D");
-    data3->Branch("tanca_t4",   &tanca_t4,   "tanca_t4/D");
-    data3->Branch("tanca_h4",   &tanca_h4,   "tanca_h4/D");
+    // preparation is started well before the boundary, usually finished
+    if (preparing.valid()) preparing.wait();
+    preparing = TaskFuture();
+
+    std::shared_ptr<OutputFile> prepared;
+    {
+        std::lock_guard<std::mutex> lock(nextMtx);
+        prepared = std::move(next);
+    }
+
+    // not prepared or failed, open now
+    if (!prepared) {
+        ERR->logInfo("RootTreeWriter::rotateFile: next file not prepared, opening it now");
+        configureImplicitMT();
+        prepared = createFile(start);
+        if (!prepared) return false;
+    }
+
+    // switch, new events go to the new file from here on
+    std::shared_ptr<OutputFile> old = std::move(current);
+    current = std::move(prepared);
+    unflushedBytes = 0;
+
+    // forget finished finalizations
+    finalizing.erase(
+        std::remove_if(finalizing.begin(), finalizing.end(), [](TaskFuture& task) {
+            return task.ready();
+        }),
+        finalizing.end()
+    );
+
+    // write last baskets, close and back up the old file in a worker
+    finalizing.push_back(TS->submit(TaskPriority::Writing, [this, old]() { finalizeFile(*old); }));
 
     return true;
 }
 
-
 bool RootTreeWriter::closeCurrentFile() {
 
     // report
     ERR->logInfo("RootTreeWriter::closeCurrentFile");
 
+    // prepared file is not needed anymore
+    discardPrepared();
+
     // check
-    if (!file) {
+    if (!current) {
         ERR->ThrowError("No File open");
         return false;
     }
 
-    file->cd();          // change to file dir
+    // all open partitions, the current file last
+    std::vector<std::shared_ptr<OutputFile>> open;
+    for (auto& [slot, out] : partitions) {
+        if (out != current) open.push_back(out);
+    }
+    open.push_back(std::move(current));
+    partitions.clear();
+    unflushedBytes = 0;
+
+    // close older partitions in parallel, the current file now, wait for all files still closing
+    for (size_t i = 0; i + 1 < open.size(); i++) {
+        std::shared_ptr<OutputFile> old = open[i];
+        finalizing.push_back(TS->submit(TaskPriority::Writing, [this, old]() { finalizeFile(*old); }));
+    }
+    bool ret = finalizeFile(*open.back());
+    joinFinalize();
+
+    return ret;
+}
+
+void RootTreeWriter::discardPrepared() {
+
+    // wait for the preparation, close and remove the file
+    if (preparing.valid()) preparing.wait();
+    preparing = TaskFuture();
+    std::shared_ptr<OutputFile> unused;
+    {
+        std::lock_guard<std::mutex> lock(nextMtx);
+        unused = std::move(next);
+    }
+    if (unused) discardFile(*unused);
+}
+
+
+// partitions by event time
+
+Long64_t RootTreeWriter::slotOf(Long64_t time) const {
+    Long64_t offset = time % partitionPeriod;
+    return time - (offset < 0 ? offset + partitionPeriod : offset);
+}
+
+Long64_t RootTreeWriter::getPartitionStart(Long64_t time) {
+    if (partitionPeriod <= 0) return std::numeric_limits<Long64_t>::min();
+    return slotOf(time);
+}
+
+std::shared_ptr<RootTreeWriter::OutputFile> RootTreeWriter::openPartition(Long64_t slot) {
+
+    // prepared in the background
+    std::shared_ptr<OutputFile> out;
+    if (preparing.valid() && nextStart == slot) {
+        preparing.wait();
+        preparing = TaskFuture();
+        std::lock_guard<std::mutex> lock(nextMtx);
+        out = std::move(next);
+    }
+
+    // not prepared, open now
+    if (!out) out = createFile(slot);
+    if (!out) return nullptr;
+
+    // the newest partition is the current file
+    partitions[slot] = out;
+    current = partitions.rbegin()->second;
+
+    return out;
+}
+
+RootTreeWriter::OutputFile& RootTreeWriter::fileFor(Long64_t time) {
+
+    // one file at a time
+    if (partitionPeriod <= 0 || partitions.empty()) return *current;
+
+    Long64_t slot = slotOf(time);
+    auto it = partitions.find(slot);
+    if (it != partitions.end()) return *it->second;
+
+    // partition already closed, keep the event in the oldest open one
+    if (slot < partitions.begin()->first) {
+        partitions.begin()->second->misplacedEvents++;
+        return *partitions.begin()->second;
+    }
+
+    // implausible time more than one period ahead
+    if (slot > partitions.rbegin()->first + partitionPeriod) {
+        current->misplacedEvents++;
+        return *current;
+    }
+
+    // first event of a new partition
+    std::shared_ptr<OutputFile> out = openPartition(slot);
+    if (!out) {
+        current->misplacedEvents++;
+        return *current;
+    }
+
+    return *out;
+}
+
+bool RootTreeWriter::advancePartitions(Long64_t watermark) {
+
+    // check
+    if (partitionPeriod <= 0 || partitions.empty()) return true;
+
+    // no events for a while, continue with the partition of the watermark
+    if (watermark >= partitions.rbegin()->first + partitionPeriod) {
+        if (!openPartition(slotOf(watermark))) return false;
+    }
+
+    // prepare the next partition in the background (forget one prepared for a skipped slot)
+    Long64_t nextSlot = partitions.rbegin()->first + partitionPeriod;
+    if (preparing.valid() && nextStart < nextSlot) discardPrepared();
+    if (watermark >= nextSlot - static_cast<Long64_t>(CC->rotationPrepareLead * 1e9)) prepareNextFile(nextSlot);
+
+    // close partitions that cannot get events anymore (the newest stays open)
+    Long64_t grace = static_cast<Long64_t>(CC->partitionGrace * 1e9);
+    while (partitions.size() > 1 && partitions.begin()->first + partitionPeriod + grace <= watermark) {
+        std::shared_ptr<OutputFile> old = partitions.begin()->second;
+        partitions.erase(partitions.begin());
+
+        // forget finished finalizations
+        finalizing.erase(
+            std::remove_if(finalizing.begin(), finalizing.end(), [](TaskFuture& task) {
+                return task.ready();
+            }),
+            finalizing.end()
+        );
+
+        finalizing.push_back(TS->submit(TaskPriority::Writing, [this, old]() { finalizeFile(*old); }));
+    }
+
+    return true;
+}
+
+void RootTreeWriter::joinFinalize() {
+
+    // wait till all old files are closed
+    for (auto& task : finalizing) {
+        if (task.valid()) task.wait();
+    }
+    finalizing.clear();
+}
+
+void RootTreeWriter::configureImplicitMT() {
+
+    // parallel basket compression
+    if (CC->enableImplicitMT && !ROOT::IsImplicitMTEnabled()) {
+        ROOT::EnableImplicitMT(static_cast<UInt_t>(std::max(CC->implicitMTThreads, 0)));
+    } else if (!CC->enableImplicitMT && ROOT::IsImplicitMTEnabled()) {
+        ROOT::DisableImplicitMT();
+    }
+}
+
+std::shared_ptr<RootTreeWriter::OutputFile> RootTreeWriter::createFile(Long64_t time) {
+
+    auto out = std::make_shared<OutputFile>();
+    out->start = time;
+
+    // set fileName, folderName and filePath from the start of the file (UTC)
+    std::time_t t = static_cast<std::time_t>(time / 1000000000LL);
+    std::tm tm{};
+    gmtime_r(&t, &tm);
+
+    char buf[32];
+
+    // get folder name
+    std::strftime(buf, sizeof(buf), "%Y_%m_%d", &tm);
+    out->folderName = static_cast<std::string>(buf);
+
+    // create folder if it doesnt exist
+    fs::path folder = fs::path(CC->workingDir) / out->folderName;
+    fs::create_directories(folder);
+
+    // get file name: start time and sequence number of the day (a restart never overwrites a file)
+    std::strftime(buf, sizeof(buf), "%Y_%m_%d_%H%M%S", &tm);
+    char sequence[16];
+    std::snprintf(sequence, sizeof(sequence), "_tanca_%04d.root", nextSequence(folder));
+    out->fileName = static_cast<std::string>(buf) + sequence;
+
+    // get total file path
+    out->filePath = folder / out->fileName;
+
+    // waveforms in a separate file next to the summary file
+    out->splitFile = CC->splitWaveforms && CC->outputFormat == OutputFormat::TTree;
+    out->waveformPath = out->splitFile ? out->filePath.parent_path() / (out->filePath.stem().string() + "_waveforms.root") : out->filePath;
+
+    // log the ranges ROOT writes again for the backup streamed meanwhile
+    if (CC->enableBackup) {
+        out->rewrites = std::make_shared<RewriteLog>();
+        out->waveformRewrites = out->splitFile ? std::make_shared<RewriteLog>() : out->rewrites;
+    }
+
+    // open new file(s) with configured compression and check
+    if (CC->bufferMergerFillers > 0 && CC->outputFormat == OutputFormat::TTree) {
+
+        // fillers write into memory files, the merger appends them to the output file
+        out->merger = std::make_unique<ROOT::TBufferMerger>(std::unique_ptr<TFile>(new TrackedFile(out->waveformPath.c_str(), "RECREATE", "", compressionSettings(*CC), out->waveformRewrites)));
+        out->mergerFile = out->merger->GetFile();
+        out->waveformFile = out->mergerFile.get();
+        out->file = out->splitFile ? new TrackedFile(out->filePath.c_str(), "RECREATE", "", compressionSettings(*CC), out->rewrites) : out->waveformFile;
+    } else {
+        out->file = new TrackedFile(out->filePath.c_str(), "RECREATE", "", compressionSettings(*CC), out->rewrites);
+        out->waveformFile = out->splitFile ? new TrackedFile(out->waveformPath.c_str(), "RECREATE", "", compressionSettings(*CC), out->waveformRewrites) : out->file;
+    }
+    if (!out->file || out->file->IsZombie() || !out->waveformFile || out->waveformFile->IsZombie()) {
+        ERR->ThrowError("error when opening the ROOT current file");
+        if (out->file != out->waveformFile && out->file != out->mergerFile.get()) delete out->file;
+        if (out->waveformFile != out->mergerFile.get()) delete out->waveformFile;
+        out->file = nullptr;
+        out->waveformFile = nullptr;
+        out->mergerFile.reset();
+        out->merger.reset();
+        return nullptr;
+    }
+
+    // statistics
+    out->openTime = std::chrono::steady_clock::now();
+
+    // create new TTree
+    out->features = new TTree("features", "Digitizer Features", 99, out->file);
+    out->degradation = new TTree("degradation", "Degradation Level Changes", 99, out->file);
+    out->alarms = new TTree("alarms", "Rate Burst Alarms", 99, out->file);
+
+    // digitizer and arduino data as raw log, RNTuples or TTrees
+    if (CC->outputFormat == OutputFormat::RawLog) {
+        out->rawLog = std::make_unique<RawLogWriter>(CC, ERR, TS);
+        if (!out->rawLog->open(out->filePath.parent_path() / out->filePath.stem())) {
+            out->rawLog.reset();
+            closeFile(*out);
+            return nullptr;
+        }
+    } else if (CC->outputFormat == OutputFormat::RNTuple) {
+        try {
+            out->ntuples = std::make_unique<NTupleOutput>();
+            out->ntuples->open(out->file, compressionSettings(*CC));
+        } catch (const std::exception& e) {
+            ERR->ThrowError(std::string("error when creating the RNTuples: ") + e.what());
+            out->ntuples.reset();
+            closeFile(*out);
+            return nullptr;
+        }
+    } else {
+        out->data1 = createWaveformTree(out->data1Buffer, out->waveformFile);
+        out->data2 = new TTree("data2", "Arduino Data 1", 99, out->file);
+        out->data3 = new TTree("data3", "Arduino Data 2", 99, out->file);
+
+        // define Branches
+        out->data2->Branch("ts_data2",   &ts_data2,   "ts_data2/L");
+        out->data2->Branch("rate",       &rate,       "rate/D");
+        out->data2->Branch("pressure",   &pressure,   "pressure/D");
 
-    // write TTrees in file
-    if (data1 && data2 && data3) {
-        data1->Write();
-        data2->Write();
-        data3->Write();
+        out->data3->Branch("ts_data3",   &ts_data3,   "ts_data3/L");
+        out->data3->Branch("tanca_h2",   &tanca_h2,   "tanca_h2/D");
+        out->data3->Branch("tanca_t1",   &tanca_t1,   "tanca_t1/D");
+        out->data3->Branch("tanca_h1",   &tanca_h1,   "tanca_h1/D");
+        out->data3->Branch("tanca_t2",   &tanca_t2,   "tanca_t2/D");
+        out->data3->Branch("tanca_t3",   &tanca_t3,   "tanca_t3/D");
+        out->data3->Branch("tanca_h3",   &tanca_h3,   "tanca_h3/D");
+        out->data3->Branch("tanca_t4",   &tanca_t4,   "tanca_t4/D");
+        out->data3->Branch("tanca_h4",   &tanca_h4,   "tanca_h4/D");
     }
 
-    file->Close();       // close the ROOT file (will also delete the TTrees)
-    delete file;         // clear storage
-    file = nullptr;      // reset pointer
-    data1 = nullptr;
-    data2 = nullptr;
-    data3 = nullptr;
+    out->features->Branch("ts_features",     &ts_features,                       "ts_features/L");
+    out->features->Branch("eventID",         &featureEventID,                    "eventID/l");
+    out->features->Branch("baseline",        featureValues.baseline.data(),      "baseline[3]/D");
+    out->features->Branch("amplitude",       featureValues.amplitude.data(),     "amplitude[3]/D");
+    out->features->Branch("charge",          featureValues.charge.data(),        "charge[3]/D");
+    out->features->Branch("peakPosition",    featureValues.peakPosition.data(),  "peakPosition[3]/I");
+    out->features->Branch("pressure",        &environment.pressure,              "pressure/D");
+    out->features->Branch("temperature",     &environment.temperature,           "temperature/D");
+    out->features->Branch("data2Entry",      &environment.data2Entry,            "data2Entry/L");
+
+    out->degradation->Branch("ts_degradation",   &ts_degradation,    "ts_degradation/L");
+    out->degradation->Branch("level",            &level,             "level/I");
+    out->degradation->Branch("queueDepth",       &queueDepth,        "queueDepth/L");
+    out->degradation->Branch("writerLag",        &writerLag,         "writerLag/D");
+
+    out->alarms->Branch("ts_alarm",      &alarm.time,            "ts_alarm/L");
+    out->alarms->Branch("timescale",     &alarm.timescale,       "timescale/D");
+    out->alarms->Branch("counts",        &alarm.counts,          "counts/L");
+    out->alarms->Branch("expected",      &alarm.expected,        "expected/D");
+    out->alarms->Branch("significance",  &alarm.significance,    "significance/D");
+
+    // basket size and flush interval
+    for (TTree* tree : {out->data2, out->data3, out->features, out->degradation, out->alarms}) {
+        if (tree) configureTree(tree);
+    }
+
+    // one data1 tree per filler, merged into data1 of the output file
+    for (int i = 0; out->merger && i < CC->bufferMergerFillers; i++) {
+        auto filler = std::make_unique<Filler>();
+        filler->file = out->merger->GetFile();
+        filler->data1 = createWaveformTree(filler->buffer, filler->file.get());
+        out->fillers.push_back(std::move(filler));
+    }
+
+    // marker till the file is closed
+    std::vector<fs::path> rootFiles = {out->filePath};
+    if (out->splitFile) rootFiles.push_back(out->waveformPath);
+    if (!FileRecovery::writeMarker(out->filePath, rootFiles)) {
+        ERR->logInfo("RootTreeWriter::createFile: cannot write marker of " + out->filePath.string());
+    }
+
+    // stream backup while the file is written
+    if (CC->enableBackup) {
+        fs::path folder = out->folderName;
+        BE.track(out->filePath, folder / out->filePath.filename(), out->rewrites);
+        if (out->splitFile && CC->backupWaveforms) BE.track(out->waveformPath, folder / out->waveformPath.filename(), out->waveformRewrites);
+    }
+
+    return out;
+}
+
+void RootTreeWriter::configureTree(TTree* tree) {
+    tree->SetBasketSize("*", std::max(CC->basketSize, 1024));
+    if (CC->autoFlushMB > 0) tree->SetAutoFlush(-static_cast<Long64_t>(CC->autoFlushMB * 1e6));
+    if (CC->checkpointMB > 0) tree->SetAutoSave(-static_cast<Long64_t>(CC->checkpointMB * 1e6));
+}
+
+TTree* RootTreeWriter::createWaveformTree(WaveformBuffer& buffer, TDirectory* dir) {
+
+    TTree* tree = new TTree("data1", "Digitizer Data", 99, dir);
+    tree->Branch("ts_data1",   &buffer.ts_data1,   "ts_data1/L");
+    tree->Branch("eventID",    &buffer.eventID,    "eventID/l");
+
+    // waveforms as UShort_t arrays, sized from the record length (trimmed waveforms are shorter)
+    for (int channel = 0; channel <= 2; channel++) {
+        std::string n = "ns" + std::to_string(channel);
+        std::string ch = "ch" + std::to_string(channel);
+        buffer.waveform[channel].assign(std::max<size_t>(DC->recordLength, 1), 0);
+        tree->Branch(n.c_str(),  &buffer.nSamples[channel],         (n + "/I").c_str());
+        tree->Branch(ch.c_str(), buffer.waveform[channel].data(),   (ch + "[" + n + "]/s").c_str());
+    }
+
+    configureTree(tree);
+
+    return tree;
+}
+
+
+bool RootTreeWriter::closeFile(OutputFile& out) {
+
+    // commit RNTuples
+    out.ntuples.reset();
+
+    // write last raw log buffer
+    if (out.rawLog) {
+        out.rawLog->close();
+        out.rawSegments = out.rawLog->getSegments();
+        out.rawLog.reset();
+    }
+
+    // waveforms first, the summary file links to them
+    if (out.merger) {
+
+        // fill remaining events, send all memory files to the merger
+        closeFillers(out);
+        out.mergerFile->Write();
+        if (out.file == out.mergerFile.get()) out.file = nullptr;
+        out.mergerFile.reset();  // deletes the TTrees of the memory file
+        out.merger.reset();      // waits till the output file is written
+        out.data1 = nullptr;
+    } else if (out.waveformFile && out.waveformFile != out.file) {
+        out.waveformFile->cd();
+        if (out.data1) out.data1->Write("", TObject::kOverwrite);
+        out.waveformFile->Close();
+        delete out.waveformFile;
+        out.data1 = nullptr;
+    }
+    out.waveformFile = nullptr;
+
+    // summary file
+    bool ret = true;
+    if (out.file) {
+        if (out.splitFile) ret = linkWaveforms(out);
+
+        out.file->cd();          // change to file dir
+
+        // write TTrees in file (replacing the header of the last checkpoint)
+        for (TTree* tree : {out.data1, out.data2, out.data3, out.features, out.degradation, out.alarms}) {
+            if (tree) tree->Write("", TObject::kOverwrite);
+        }
+
+        out.file->Close();       // close the ROOT file (will also delete the TTrees)
+        delete out.file;         // clear storage
+        out.file = nullptr;      // reset pointer
+    }
+
+    out.data1 = nullptr;
+    out.data2 = nullptr;
+    out.data3 = nullptr;
+    out.features = nullptr;
+    out.degradation = nullptr;
+    out.alarms = nullptr;
+
+    // file is complete
+    FileRecovery::removeMarker(out.filePath);
+
+    return ret;
+}
+
+bool RootTreeWriter::finalizeFile(OutputFile& out) {
+
+    // report
+    ERR->logInfo("RootTreeWriter::finalizeFile: " + out.filePath.string());
+
+    auto start = std::chrono::steady_clock::now();
+    bool ret = closeFile(out);
+    out.writeNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    // report
+    reportStatistics(out);
 
     // start backup
-    if (CC->enableBackup) writeBackup();
+    if (CC->enableBackup) writeBackup(out);
+
+    return ret;
+}
+
+void RootTreeWriter::discardFile(OutputFile& out) {
+
+    // report
+    ERR->logInfo("RootTreeWriter::discardFile: " + out.filePath.string());
+
+    // close and remove the empty files
+    closeFile(out);
+    std::vector<fs::path> paths = {out.filePath};
+    if (out.splitFile) paths.push_back(out.waveformPath);
+    paths.insert(paths.end(), out.rawSegments.begin(), out.rawSegments.end());
+    for (const fs::path& path : paths) {
+        BE.cancel(path);
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+}
+
+
+int RootTreeWriter::nextSequence(const fs::path& folder) {
+
+    // highest sequence number of the files in the folder (<time>_tanca_<sequence>[_...].root/.raw)
+    int sequence = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(folder, ec)) {
+        std::string name = entry.path().filename().string();
+        size_t pos = name.find("_tanca_");
+        if (pos == std::string::npos) continue;
+        sequence = std::max(sequence, std::atoi(name.c_str() + pos + 7));
+    }
+
+    return sequence + 1;
+}
+
+Long64_t RootTreeWriter::getFileBytes() {
+
+    // check
+    if (!current) return 0;
+    OutputFile& out = *current;
 
-    return true;  
+    // size on disk, checked at most once per second
+    auto now = std::chrono::steady_clock::now();
+    if (now - out.sizeTime < std::chrono::seconds(1)) return out.fileBytes;
+    out.sizeTime = now;
+
+    std::vector<fs::path> paths = {out.filePath};
+    if (out.splitFile) paths.push_back(out.waveformPath);
+    if (out.rawLog) {
+        std::vector<fs::path> segments = out.rawLog->getSegments();
+        paths.insert(paths.end(), segments.begin(), segments.end());
+    }
+
+    out.fileBytes = 0;
+    for (const fs::path& path : paths) {
+        std::error_code ec;
+        auto size = fs::file_size(path, ec);
+        if (!ec) out.fileBytes += static_cast<Long64_t>(size);
+    }
+
+    return out.fileBytes;
+}
+
+Long64_t RootTreeWriter::getData2Entries(Long64_t time) {
+    if (!current) return 0;
+
+    // partition of the reading (filled just before)
+    auto it = partitions.find(partitionPeriod > 0 ? slotOf(time) : 0);
+    OutputFile& out = it != partitions.end() ? *it->second : *current;
+    if (out.ntuples) return out.ntuples->getData2Entries();
+    if (out.rawLog) return out.rawLog->getArduinoRecords();
+    return out.data2 ? out.data2->GetEntries() : 0;
+}
+
+
+// link summary and waveform file
+
+bool RootTreeWriter::linkWaveforms(OutputFile& out) {
+
+    // index of the waveforms by event ID (not every event has a waveform)
+    TFile* waveforms = new TrackedFile(out.waveformPath.c_str(), "UPDATE", "", compressionSettings(*CC), out.waveformRewrites);
+    if (!waveforms || waveforms->IsZombie()) {
+        ERR->ThrowError("RootTreeWriter::linkWaveforms: cannot open " + out.waveformPath.string());
+        delete waveforms;
+        return false;
+    }
+    if (TTree* tree = waveforms->Get<TTree>("data1")) {
+        tree->BuildIndex("eventID");
+        tree->Write("", TObject::kOverwrite);
+    }
+    waveforms->Close();
+    delete waveforms;
+
+    // features read data1 of the waveform file as friend (file name only, both files stay in one folder)
+    out.features->AddFriend("data1", out.waveformPath.filename().c_str());
+
+    return true;
 }
 
 
 // add events
 
-void RootTreeWriter::set_data1(Long64_t ts_data1_, std::vector<Double_t>&& ch0_, std::vector<Double_t>&& ch1_, std::vector<Double_t>&& ch2_) {
-    ts_data1 = ts_data1_;
-    ch0 = ch0_;
-    ch1 = ch1_;
-    ch2 = ch2_;
+void RootTreeWriter::set_data1(DigitizerData&& DData) {
+    OutputFile& out = fileFor(DData.eventTime);
+
+    // collect events for the fillers
+    if (out.merger) {
+        out.batch.push_back(std::move(DData));
+        if (out.batch.size() >= static_cast<size_t>(std::max(CC->bufferMergerBatch, 1))) dispatchBatch(out);
+        return;
+    }
 
     // fill data
-    data1->Fill();
+    if (out.rawLog) {
+        unflushedBytes += measure(out, [&]() { return static_cast<Long64_t>(out.rawLog->appendDigitizer(DData)); });
+        return;
+    }
+    if (out.ntuples) {
+        unflushedBytes += measure(out, [&]() { return out.ntuples->fillData1(DData); });
+        return;
+    }
+
+    setWaveform(out.data1, out.data1Buffer, DData);
+    unflushedBytes += fill(out, out.data1);
+}
+
+void RootTreeWriter::setWaveform(TTree* tree, WaveformBuffer& buffer, const DigitizerData& DData) {
+    buffer.ts_data1 = DData.eventTime;
+    buffer.eventID = DData.eventID;
+
+    const std::vector<UShort_t>* samples[3] = {&DData.ch0, &DData.ch1, &DData.ch2};
+    for (int channel = 0; channel <= 2; channel++) {
+
+        // longer than the record length of the file
+        if (samples[channel]->size() > buffer.waveform[channel].size()) {
+            buffer.waveform[channel].resize(samples[channel]->size());
+            tree->SetBranchAddress(("ch" + std::to_string(channel)).c_str(), buffer.waveform[channel].data());
+        }
+
+        buffer.nSamples[channel] = static_cast<Int_t>(samples[channel]->size());
+        std::copy(samples[channel]->begin(), samples[channel]->end(), buffer.waveform[channel].begin());
+    }
 }
 
 void RootTreeWriter::set_data2(Long64_t ts_data2_, Double_t rate_, Double_t pressure_) {
@@ -148,7 +743,16 @@ void RootTreeWriter::set_data2(Long64_t ts_data2_, Double_t rate_, Double_t pres
     pressure = pressure_;
 
     // fill data
-    data2->Fill();
+    OutputFile& out = fileFor(ts_data2);
+    if (out.rawLog) {
+        unflushedBytes += measure(out, [&]() { return static_cast<Long64_t>(out.rawLog->appendArduino(ts_data2, rate, pressure)); });
+        return;
+    }
+    if (out.ntuples) {
+        unflushedBytes += measure(out, [&]() { return out.ntuples->fillData2(ts_data2, rate, pressure); });
+        return;
+    }
+    unflushedBytes += fill(out, out.data2);
 }
 
 void RootTreeWriter::set_data3(Long64_t ts_data3_, Double_t tanca_h1_, Double_t tanca_t1_, Double_t tanca_h2_, Double_t tanca_t2_, Double_t tanca_h3_, Double_t tanca_t3_, Double_t tanca_h4_, Double_t tanca_t4_) {
@@ -163,59 +767,345 @@ void RootTreeWriter::set_data3(Long64_t ts_data3_, Double_t tanca_h1_, Double_t
     tanca_t4 = tanca_t4_;
 
     // fill data
-    data3->Fill();
+    OutputFile& out = fileFor(ts_data3);
+    std::array<Double_t, 8> tanca = {tanca_h1, tanca_t1, tanca_h2, tanca_t2, tanca_h3, tanca_t3, tanca_h4, tanca_t4};
+    if (out.rawLog) {
+        unflushedBytes += measure(out, [&]() { return static_cast<Long64_t>(out.rawLog->appendTanca(ts_data3, tanca)); });
+        return;
+    }
+    if (out.ntuples) {
+        unflushedBytes += measure(out, [&]() { return out.ntuples->fillData3(ts_data3, tanca); });
+        return;
+    }
+    unflushedBytes += fill(out, out.data3);
 }
 
+void RootTreeWriter::set_features(Long64_t ts_features_, ULong64_t eventID_, const DigitizerFeatures& features_, const EnvironmentContext& environment_) {
+    ts_features = ts_features_;
+    featureEventID = eventID_;
+    featureValues = features_;
+    environment = environment_;
 
-// write backup
+    // fill data
+    OutputFile& out = fileFor(ts_features);
+    unflushedBytes += fill(out, out.features);
+}
 
-bool RootTreeWriter::writeBackup() {
-    
-    // prepare source and dest file paths
-    fs::path source = filePath;
-    fs::path dest = fs::path(CC->backupDir) / folderName / fileName;
+void RootTreeWriter::set_degradation(Long64_t ts_degradation_, Int_t level_, Long64_t queueDepth_, Double_t writerLag_) {
+    ts_degradation = ts_degradation_;
+    level = level_;
+    queueDepth = queueDepth_;
+    writerLag = writerLag_;
 
-    // report
-    ERR->logInfo("RootTreeWriter::writeBackup: " + source.string());
+    // fill data
+    OutputFile& out = fileFor(ts_degradation);
+    unflushedBytes += fill(out, out.degradation);
+}
+
+void RootTreeWriter::set_alarm(const BurstAlarm& alarm_) {
+    alarm = alarm_;
+
+    // fill data
+    OutputFile& out = fileFor(alarm.time);
+    unflushedBytes += fill(out, out.alarms);
+}
+
+
+Int_t RootTreeWriter::fill(OutputFile& out, TTree* tree) {
+    return static_cast<Int_t>(measure(out, [tree]() { return static_cast<Long64_t>(tree->Fill()); }));
+}
+
+
+// parallel filling of data1
+
+void RootTreeWriter::dispatchBatch(OutputFile& out) {
+
+    // check
+    if (out.batch.empty()) return;
+
+    // forget finished tasks
+    out.fillerTasks.erase(
+        std::remove_if(out.fillerTasks.begin(), out.fillerTasks.end(), [](TaskFuture& task) {
+            return task.ready();
+        }),
+        out.fillerTasks.end()
+    );
+
+    // fill in a worker (the file waits for its fillers before closing)
+    auto events = std::make_shared<std::vector<DigitizerData>>(std::move(out.batch));
+    out.batch.clear();
+    out.fillerBytes += events->size() * sizeof(UShort_t) * DC->recordLength * 3;
+    out.fillerTasks.push_back(TS->submit(TaskPriority::Writing, [this, &out, events]() { fillBatch(out, *events); }));
+}
+
+void RootTreeWriter::fillBatch(OutputFile& out, const std::vector<DigitizerData>& events) {
+
+    // take a free filler, start with the next one in turn
+    size_t start = out.nextFiller.fetch_add(1);
+    for (size_t k = 0; k < out.fillers.size(); k++) {
+        Filler& filler = *out.fillers[(start + k) % out.fillers.size()];
+        std::unique_lock<std::mutex> lock(filler.mtx, std::try_to_lock);
+        if (lock.owns_lock()) {
+            fillWith(out, filler, events);
+            return;
+        }
+    }
+
+    // all busy, wait for one
+    Filler& filler = *out.fillers[start % out.fillers.size()];
+    std::lock_guard<std::mutex> lock(filler.mtx);
+    fillWith(out, filler, events);
+}
+
+void RootTreeWriter::fillWith(OutputFile& out, Filler& filler, const std::vector<DigitizerData>& events) {
+
+    // fill events in order of the batch
+    for (const DigitizerData& DData : events) {
+        setWaveform(filler.data1, filler.buffer, DData);
+        filler.unwrittenBytes += fill(out, filler.data1);
+    }
 
-    // start copy
-    if (!backupRunning.load()) {
-        backupThread = std::thread(&RootTreeWriter::copyFile, this, source, dest);
-        return true;
+    // send memory file to the merger (also at a checkpoint)
+    if (filler.unwrittenBytes > static_cast<Long64_t>(CC->autoFlushMB * 1e6) || filler.checkpoint != out.checkpoints.load()) {
+        sendFiller(out, filler);
     }
 
-    ERR->ThrowError("RootTreeWriter::writeBackup: Backup failed: " + source.string());
-    ERR->ThrowError("Previous backup is still running");
+    out.fillerBytes -= std::min(out.fillerBytes.load(), events.size() * sizeof(UShort_t) * DC->recordLength * 3);
+}
+
+void RootTreeWriter::sendFiller(OutputFile& out, Filler& filler) {
+    filler.checkpoint = out.checkpoints.load();
+    auto start = std::chrono::steady_clock::now();
+    filler.file->Write();
+    out.writeNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    filler.unwrittenBytes = 0;
+}
+
+void RootTreeWriter::closeFillers(OutputFile& out) {
 
-    return false;
+    // fill remaining events and wait
+    dispatchBatch(out);
+    for (auto& task : out.fillerTasks) {
+        if (task.valid()) task.wait();
+    }
+    out.fillerTasks.clear();
+
+    // send memory files to the merger, deletes the filler trees
+    for (auto& filler : out.fillers) {
+        filler->file->Write();
+        filler->file.reset();
+    }
+    out.fillers.clear();
+    out.fillerBytes = 0;
 }
 
-void RootTreeWriter::copyFile(fs::path source, fs::path dest) {
+void RootTreeWriter::reportStatistics(const OutputFile& out) {
 
-    // status
-    backupRunning.store(true);
+    // bytes before and after compression (files are closed)
+    Long64_t totBytes = out.filledBytes.load();
+    Long64_t zipBytes = 0;
+    std::vector<fs::path> paths = {out.filePath};
+    if (out.splitFile) paths.push_back(out.waveformPath);
+    paths.insert(paths.end(), out.rawSegments.begin(), out.rawSegments.end());
+    for (const fs::path& path : paths) {
+        std::error_code ec;
+        auto size = fs::file_size(path, ec);
+        if (!ec) zipBytes += static_cast<Long64_t>(size);
+    }
 
-    // create dest folder if it doesnt exist
-    fs::create_directories(dest.parent_path());
+    double seconds = out.writeNanoseconds.load() / 1e9;
+    double fileSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - out.openTime).count();
 
-    std::cout << "copy file " << source << " to " << dest << std::endl;
-    fs::copy_file(
-        source,
-        dest,
-        fs::copy_options::overwrite_existing
+    char buf[256];
+    std::snprintf(buf, sizeof(buf),
+        "%.1f MB -> %.1f MB (ratio %.2f), %.1f MB/s while writing, %.3f MB/s average",
+        totBytes / 1e6,
+        zipBytes / 1e6,
+        zipBytes > 0 ? static_cast<double>(totBytes) / zipBytes : 0.0,
+        seconds > 0 ? totBytes / 1e6 / seconds : 0.0,
+        fileSeconds > 0 ? zipBytes / 1e6 / fileSeconds : 0.0
     );
 
-    // status
-    backupRunning.store(false);
+    // report
+    ERR->logInfo("RootTreeWriter::reportStatistics: " + out.filePath.filename().string() + ": " + buf);
+
+    // events whose partition was already closed
+    if (out.misplacedEvents > 0) {
+        ERR->logInfo("RootTreeWriter::reportStatistics: " + out.filePath.filename().string() + ": " + std::to_string(out.misplacedEvents) + " event(s) outside the time slot");
+    }
 }
 
 
-// join backup
+// flush baskets
 
-void RootTreeWriter::joinBackup() {
+void RootTreeWriter::flushBaskets() {
+
+    // check
+    if (!current) return;
+
+    // current file or all open partitions
+    std::vector<OutputFile*> open = {current.get()};
+    if (!partitions.empty()) {
+        open.clear();
+        for (auto& [slot, out] : partitions) open.push_back(out.get());
+    }
+
+    for (OutputFile* out : open) {
+
+        // pending waveforms go to the fillers
+        if (out->merger) dispatchBatch(*out);
+
+        // write baskets of all trees to file
+        auto start = std::chrono::steady_clock::now();
+        for (TTree* tree : {out->data1, out->data2, out->data3, out->features, out->degradation, out->alarms}) {
+            if (tree) tree->FlushBaskets();
+        }
+        if (out->ntuples) out->ntuples->commitCluster();
+        if (out->rawLog) out->rawLog->flush();
+        out->writeNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // report
+    if (CC->detailedLog) {
+        ERR->logInfo("RootTreeWriter::flushBaskets: " + std::to_string(unflushedBytes) + " bytes");
+    }
+
+    unflushedBytes = 0;
+}
+
+
+// checkpoint
+
+void RootTreeWriter::checkpoint() {
+
+    // check
+    if (!current) return;
+
+    // baskets of all open files
+    flushBaskets();
+
+    // current file or all open partitions
+    std::vector<OutputFile*> open = {current.get()};
+    if (!partitions.empty()) {
+        open.clear();
+        for (auto& [slot, out] : partitions) open.push_back(out.get());
+    }
+
+    for (OutputFile* out : open) {
+        auto start = std::chrono::steady_clock::now();
+
+        // fillers send their memory files in a worker (or with their next batch), the trees of the merger file now
+        bool merged = out->merger && out->file == out->mergerFile.get();
+        if (out->merger) {
+            out->checkpoints++;
+            for (auto& filler : out->fillers) {
+                Filler* f = filler.get();
+                out->fillerTasks.push_back(TS->submit(TaskPriority::Writing, [this, out, f]() {
+                    std::lock_guard<std::mutex> lock(f->mtx);
+                    if (f->checkpoint != out->checkpoints.load()) sendFiller(*out, *f);
+                }));
+            }
+        }
+        if (merged) out->mergerFile->Write();
+
+        // tree headers and key list (the baskets are written already)
+        for (TTree* tree : {out->data1, out->data2, out->data3, out->features, out->degradation, out->alarms}) {
+            if (tree && !merged) tree->AutoSave("SaveSelf");
+        }
+
+        out->writeNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // report
+    if (CC->detailedLog) {
+        ERR->logInfo("RootTreeWriter::checkpoint: " + current->filePath.filename().string());
+    }
+}
+
+
+// recovery
+
+void RootTreeWriter::recoverFiles() {
+
+    // markers of files that were not closed
+    std::vector<fs::path> markers = FileRecovery::findMarkers(CC->workingDir);
+    if (markers.empty()) return;
+
+    // report
+    ERR->logInfo("RootTreeWriter::recoverFiles: " + std::to_string(markers.size()) + " file(s) of a crashed run");
+
+    // recover in the background, then back up like a closed file
+    finalizing.push_back(TS->submit(TaskPriority::Writing, [this, markers]() {
+        for (const fs::path& marker : markers) {
+            std::vector<fs::path> paths = FileRecovery::readMarker(marker);
+
+            bool recovered = !paths.empty();
+            for (const fs::path& path : paths) {
+                std::string report;
+                recovered = FileRecovery::recover(path, report) && recovered;
+                ERR->logInfo("RootTreeWriter::recoverFiles: " + report);
+            }
+
+            // not tried again on the next start, copies of the last run are given up
+            if (!recovered) {
+                if (CC->enableBackup) {
+                    for (const fs::path& path : paths) BE.cancel(path);
+                }
+                fs::path failed = FileRecovery::markFailed(marker);
+                ERR->ThrowError("RootTreeWriter::recoverFiles: cannot recover the files of " + failed.string());
+                continue;
+            }
+
+            // summary file first, waveform file and raw segments of the same name
+            OutputFile out;
+            out.filePath = paths[0];
+            out.fileName = out.filePath.filename().string();
+            out.folderName = out.filePath.parent_path().filename().string();
+            out.splitFile = paths.size() > 1;
+            out.waveformPath = out.splitFile ? paths[1] : paths[0];
+            std::error_code ec;
+            std::string stem = out.filePath.stem().string() + "_";
+            for (const auto& entry : fs::directory_iterator(out.filePath.parent_path(), ec)) {
+                std::string name = entry.path().filename().string();
+                if (entry.path().extension() == ".raw" && name.compare(0, stem.size(), stem) == 0) out.rawSegments.push_back(entry.path());
+            }
+            std::sort(out.rawSegments.begin(), out.rawSegments.end());
+
+            fs::remove(marker, ec);
+            if (CC->enableBackup) writeBackup(out);
+        }
+    }));
+}
+
+
+// write backup
+
+bool RootTreeWriter::writeBackup(const OutputFile& out) {
     
-    // wait till copy is finished
-    if (backupThread.joinable()) {
-        backupThread.join();
+    // prepare source file paths (summary first, waveforms if configured)
+    std::vector<fs::path> sources = {out.filePath};
+    if (CC->backupWaveforms) {
+        if (out.splitFile) sources.push_back(out.waveformPath);
+        sources.insert(sources.end(), out.rawSegments.begin(), out.rawSegments.end());
     }
-}
\ No newline at end of file
+    fs::path folder = out.folderName;
+
+    // report
+    ERR->logInfo("RootTreeWriter::writeBackup: " + out.filePath.string());
+
+    // copy the rest (streamed while the file was written)
+    for (const fs::path& source : sources) {
+        BE.complete(source, folder / source.filename());
+    }
+
+    return true;
+}
+
+
+// join backup
+
+void RootTreeWriter::joinBackup() {
+
+    // copy all closed files, failed copies are retried on the next start
+    BE.drain();
+}
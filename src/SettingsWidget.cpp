@@ -43,16 +43,28 @@ Settings::Settings (QWidget *parent)
     enableAcquisitionLimitCB = new QCheckBox("Enable Acuisition Limit");
     acquisitionLimitSB = new QSpinBox;
     acquisitionLimitSB->setRange(0, 1000000);
+    acquisitionLimitModeCB = new QComboBox;
+    acquisitionLimitModeCB->addItems({"First Events", "Time Uniform"});
 
     connect(enableAcquisitionLimitCB, &QCheckBox::clicked, this, [=]() {
         if (enableAcquisitionLimitCB->checkState()) {
             acquisitionLimitSB->setVisible(true);
+            acquisitionLimitModeCB->setVisible(true);
         }
         else {
             acquisitionLimitSB->setVisible(false);
+            acquisitionLimitModeCB->setVisible(false);
         }
     }),
 
+    enableFlightRecorderCB = new QCheckBox("Enable Flight Recorder [s]");
+    flightRecorderSecondsSB = new QSpinBox;
+    flightRecorderSecondsSB->setRange(1, 3600);
+
+    connect(enableFlightRecorderCB, &QCheckBox::clicked, this, [=]() {
+        flightRecorderSecondsSB->setVisible(enableFlightRecorderCB->isChecked());
+    });
+
     generalSettingsLayout->addWidget(workingDirL, 0, 0, 1, 1);
     generalSettingsLayout->addWidget(workingDirLE, 0, 1, 1, 2);
     generalSettingsLayout->addWidget(workingDirPB, 0, 3, 1, 1);
@@ -65,7 +77,11 @@ Settings::Settings (QWidget *parent)
     generalSettingsLayout->addWidget(enableDetailledLogCB, 2, 2, 1, 2);
 
     generalSettingsLayout->addWidget(enableAcquisitionLimitCB, 3, 0, 1, 2);
-    generalSettingsLayout->addWidget(acquisitionLimitSB, 3, 2, 1, 2);
+    generalSettingsLayout->addWidget(acquisitionLimitSB, 3, 2, 1, 1);
+    generalSettingsLayout->addWidget(acquisitionLimitModeCB, 3, 3, 1, 1);
+
+    generalSettingsLayout->addWidget(enableFlightRecorderCB, 4, 0, 1, 2);
+    generalSettingsLayout->addWidget(flightRecorderSecondsSB, 4, 2, 1, 2);
 
     // Digitizer Settings Group Box
     digitizerSettingsGB = new QGroupBox("Digitizer Settings", this);
@@ -148,6 +164,10 @@ void Settings::applySettings(
 
     cc->enableAcquisitionLimit = enableAcquisitionLimitCB->isChecked();
     cc->acquisitionLimit = acquisitionLimitSB->value();
+    cc->acquisitionLimitMode = static_cast<AcquisitionLimitMode>(acquisitionLimitModeCB->currentIndex());
+
+    cc->enableFlightRecorder = enableFlightRecorderCB->isChecked();
+    cc->flightRecorderSeconds = flightRecorderSecondsSB->value();
 
     // apply digitizer config settings
     dc->recordLength = static_cast<uint32_t>(recordLengthCB->currentText().toInt());
@@ -191,7 +211,13 @@ void Settings::getSettings(
 
     enableAcquisitionLimitCB->setChecked(cc->enableAcquisitionLimit);
     if (!cc->enableAcquisitionLimit) acquisitionLimitSB->setVisible(false);
+    if (!cc->enableAcquisitionLimit) acquisitionLimitModeCB->setVisible(false);
     acquisitionLimitSB->setValue(cc->acquisitionLimit);
+    acquisitionLimitModeCB->setCurrentIndex(static_cast<int>(cc->acquisitionLimitMode));
+
+    enableFlightRecorderCB->setChecked(cc->enableFlightRecorder);
+    flightRecorderSecondsSB->setVisible(cc->enableFlightRecorder);
+    flightRecorderSecondsSB->setValue(cc->flightRecorderSeconds);
 
     // apply digitizer config settings
     recordLengthCB->setCurrentText(QString::fromStdString(std::to_string(dc->recordLength)));
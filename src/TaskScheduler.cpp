@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <exception>
+
+#include <TaskScheduler.h>
+#include <CollectorConfig.h>
+#include <ErrorHandler.h>
+
+thread_local TaskScheduler* TaskScheduler::currentScheduler = nullptr;
+thread_local size_t TaskScheduler::currentWorker = 0;
+
+
+// constructor and destructor
+
+TaskScheduler::TaskScheduler(
+    std::shared_ptr<CollectorConfig> cc,
+    ErrorHandler *err
+) : CC(cc),
+    ERR(err)
+{}
+
+TaskScheduler::~TaskScheduler() {
+    stop();
+}
+
+
+// steering
+
+bool TaskScheduler::start() {
+
+    // check
+    if (isRunning.load()) return true;
+
+    // number of workers (at least two, so a blocked readout cannot stall the processing)
+    size_t numWorkers = CC->schedulerThreads > 0
+        ? static_cast<size_t>(CC->schedulerThreads)
+        : static_cast<size_t>(std::thread::hardware_concurrency());
+    numWorkers = std::max<size_t>(numWorkers, 2);
+
+    // report
+    ERR->logInfo("TaskScheduler::start: " + std::to_string(numWorkers) + " worker(s)");
+
+    // create all deques before the first worker can steal
+    for (size_t i = 0; i < numWorkers; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+
+    // set status
+    isStopping.store(false);
+    isRunning.store(true);
+
+    // start threads
+    for (size_t i = 0; i < numWorkers; i++) {
+        workers[i]->thread = std::thread(&TaskScheduler::workerLoop, this, i);
+    }
+    timerThread = std::thread(&TaskScheduler::timerLoop, this);
+
+    return true;
+}
+
+void TaskScheduler::stop() {
+
+    // check
+    if (!isRunning.load()) return;
+
+    // report
+    ERR->logInfo("TaskScheduler::stop");
+
+    // stop timer wheel
+    {
+        std::lock_guard<std::mutex> lock(timerMtx);
+        isStopping.store(true);
+    }
+    timerCond.notify_all();
+    if (timerThread.joinable()) timerThread.join();
+
+    // workers finish the queued tasks and return
+    {
+        std::lock_guard<std::mutex> lock(sleepMtx);
+    }
+    sleepCond.notify_all();
+    for (auto& worker : workers) {
+        if (worker->thread.joinable()) worker->thread.join();
+    }
+
+    // clear
+    workers.clear();
+    for (auto& slot : wheel) slot.clear();
+    timers.clear();
+
+    // set status
+    isRunning.store(false);
+}
+
+
+// tasks
+
+TaskFuture TaskScheduler::submit(TaskPriority priority, std::function<void()> task) {
+
+    // report errors of the task instead of losing them in the future
+    TaskFuture result;
+    result.task = std::make_shared<TaskFuture::Task>();
+    result.task->function = std::packaged_task<void()>([this, task = std::move(task)]() {
+        try {
+            task();
+        } catch (const std::exception& e) {
+            ERR->ThrowError(std::string("TaskScheduler: task failed: ") + e.what());
+        }
+    });
+    result.future = result.task->function.get_future();
+
+    // run in the calling thread if no worker is running
+    if (!isRunning.load()) {
+        result.task->run();
+        return result;
+    }
+
+    // skipped by the worker if the waiting thread already ran it
+    push(priority, [task = result.task]() { task->run(); });
+
+    return result;
+}
+
+void TaskScheduler::push(TaskPriority priority, Task task) {
+
+    // tasks of a worker stay on its own deque, others are distributed
+    size_t index = currentScheduler == this
+        ? currentWorker
+        : nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+    // count first, so a worker never takes an uncounted task
+    queued.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(workers[index]->mtx);
+        workers[index]->tasks[static_cast<size_t>(priority)].push_back(std::move(task));
+    }
+
+    // wake a sleeping worker
+    {
+        std::lock_guard<std::mutex> lock(sleepMtx);
+    }
+    sleepCond.notify_one();
+}
+
+bool TaskScheduler::findTask(size_t index, Task& task) {
+
+    for (size_t priority = 0; priority < numPriorities; priority++) {
+
+        // own tasks (newest first)
+        {
+            Worker& own = *workers[index];
+            std::lock_guard<std::mutex> lock(own.mtx);
+            auto& tasks = own.tasks[priority];
+            if (!tasks.empty()) {
+                task = std::move(tasks.back());
+                tasks.pop_back();
+                return true;
+            }
+        }
+
+        // steal from the other workers (oldest first)
+        for (size_t k = 1; k < workers.size(); k++) {
+            Worker& other = *workers[(index + k) % workers.size()];
+            std::lock_guard<std::mutex> lock(other.mtx);
+            auto& tasks = other.tasks[priority];
+            if (!tasks.empty()) {
+                task = std::move(tasks.front());
+                tasks.pop_front();
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+void TaskScheduler::workerLoop(size_t index) {
+
+    // tasks submitted from this thread go to its own deque
+    currentScheduler = this;
+    currentWorker = index;
+
+    Task task;
+    for (;;) {
+
+        // run next task
+        if (findTask(index, task)) {
+            queued.fetch_sub(1);
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        // sleep till new tasks arrive, return if stopped and empty
+        std::unique_lock<std::mutex> lock(sleepMtx);
+        sleepCond.wait(lock, [&]() { return queued.load() > 0 || isStopping.load(); });
+        if (isStopping.load() && queued.load() == 0) break;
+    }
+
+    currentScheduler = nullptr;
+}
+
+
+// timer wheel
+
+TimerID TaskScheduler::schedule(
+    TaskPriority priority,
+    std::chrono::nanoseconds delay,
+    std::chrono::nanoseconds period,
+    std::function<void()> task
+) {
+    // convert to ticks (at least one)
+    auto toTicks = [](std::chrono::nanoseconds duration) {
+        return static_cast<uint64_t>(std::max<int64_t>((duration + tick - std::chrono::nanoseconds(1)) / tick, 1));
+    };
+
+    auto timer = std::make_shared<Timer>();
+    timer->priority = priority;
+    timer->periodTicks = period.count() > 0 ? toTicks(period) : 0;
+    timer->task = std::move(task);
+
+    // add to wheel
+    std::lock_guard<std::mutex> lock(timerMtx);
+    timer->id = nextTimerID++;
+    timers[timer->id] = timer;
+    insertTimer(timer, toTicks(delay));
+
+    return timer->id;
+}
+
+void TaskScheduler::cancel(TimerID id) {
+
+    // remove from map (the wheel drops it on the next visit)
+    std::shared_ptr<Timer> timer;
+    {
+        std::lock_guard<std::mutex> lock(timerMtx);
+        auto it = timers.find(id);
+        if (it == timers.end()) return;
+        timer = it->second;
+        timers.erase(it);
+    }
+    timer->cancelled.store(true);
+
+    // cancelled by its own task
+    if (timer->runner.load() == std::this_thread::get_id()) return;
+
+    // wait for a running instance
+    std::lock_guard<std::mutex> lock(timer->runMtx);
+}
+
+void TaskScheduler::insertTimer(const std::shared_ptr<Timer>& timer, uint64_t ticks) {
+
+    // slot and full turns of the wheel till the timer is due
+    timer->rounds = (ticks - 1) / wheelSlots;
+    wheel[(currentTick + ticks) % wheelSlots].push_back(timer);
+}
+
+void TaskScheduler::fireTimer(const std::shared_ptr<Timer>& timer) {
+
+    // skip, if the previous run is not finished
+    if (timer->inFlight.exchange(true)) return;
+
+    push(timer->priority, [this, timer]() {
+        {
+            std::lock_guard<std::mutex> lock(timer->runMtx);
+            if (!timer->cancelled.load()) {
+                timer->runner.store(std::this_thread::get_id());
+                try {
+                    timer->task();
+                } catch (const std::exception& e) {
+                    ERR->ThrowError(std::string("TaskScheduler: timer task failed: ") + e.what());
+                }
+                timer->runner.store(std::thread::id());
+            }
+        }
+        timer->inFlight.store(false);
+    });
+}
+
+void TaskScheduler::timerLoop() {
+
+    auto next = std::chrono::steady_clock::now() + tick;
+    std::vector<std::shared_ptr<Timer>> due;
+
+    std::unique_lock<std::mutex> lock(timerMtx);
+    while (!isStopping.load()) {
+
+        // wait for next tick
+        if (timerCond.wait_until(lock, next, [&]() { return isStopping.load(); })) break;
+        next += tick;
+        currentTick++;
+
+        // collect due timers of this slot
+        auto& slot = wheel[currentTick % wheelSlots];
+        for (auto it = slot.begin(); it != slot.end();) {
+            std::shared_ptr<Timer> timer = *it;
+
+            if (timer->cancelled.load()) {
+                it = slot.erase(it);
+            } else if (timer->rounds > 0) {
+                timer->rounds--;
+                ++it;
+            } else {
+                due.push_back(timer);
+                it = slot.erase(it);
+            }
+        }
+
+        // submit and reinsert periodic timers
+        for (auto& timer : due) {
+            fireTimer(timer);
+            if (timer->periodTicks > 0) insertTimer(timer, timer->periodTicks);
+            else timers.erase(timer->id);
+        }
+        due.clear();
+    }
+}
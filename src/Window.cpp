@@ -26,6 +26,9 @@ Window::Window(QWidget *parent)
 
     settingsWgt = new Settings(this);
     startButton = new QPushButton("Start");
+    dumpButton = new QPushButton("Dump Waveforms");
+    dumpButton->setVisible(false);
+    calibrateButton = new QPushButton("Calibrate");
     
     stack->addWidget(settingsWgt);
     stack->addWidget(ERR);
@@ -33,22 +36,34 @@ Window::Window(QWidget *parent)
     // Layout hinzufügen
     QVBoxLayout *layout = new QVBoxLayout(this);
     layout->addWidget(stack);
+    layout->addWidget(dumpButton);
+    layout->addWidget(calibrateButton);
     layout->addWidget(startButton);
 
     connect(startButton, &QPushButton::clicked, this, [=]() {
         onStart();
     });
 
+    connect(dumpButton, &QPushButton::clicked, this, [=]() {
+        DataC->dumpFlightRecorder();
+    });
+
+    connect(calibrateButton, &QPushButton::clicked, this, [=]() {
+        onCalibrate();
+    });
+
     // load gui values
     settingsWgt->getSettings(CC, CH, DC);
 }
 
 Window::~Window() {
+    DataC->joinCalibration();
     DataC->joinRTWBackup();
     DataC->close();
 }
 
 void Window::closeEvent(QCloseEvent *event) {
+    DataC->joinCalibration();
     DataC->joinRTWBackup();
     DataC->close();
     QWidget::closeEvent(event);
@@ -73,6 +88,7 @@ void Window::onStart() {
         }
 
         startButton->setText("Stop");
+        calibrateButton->setVisible(false);
         stack->setCurrentIndex(1);
 
         // load and save config
@@ -81,6 +97,7 @@ void Window::onStart() {
         boolret = DataC->open();
         if (!boolret) {
             startButton->setText("Start");
+            calibrateButton->setVisible(true);
             stack->setCurrentIndex(0);
             return;
         }
@@ -89,6 +106,7 @@ void Window::onStart() {
         boolret = DataC->applyDigitizerConfig();
         if (!boolret) {
             startButton->setText("Start");
+            calibrateButton->setVisible(true);
             stack->setCurrentIndex(0);
             return;
         }
@@ -97,18 +115,51 @@ void Window::onStart() {
         boolret = DataC->startAcquisition();
         if (!boolret) {
             startButton->setText("Start");
+            calibrateButton->setVisible(true);
             stack->setCurrentIndex(0);
             return;
         }
+
+        // operator dump of the flight recorder
+        dumpButton->setVisible(CC->enableFlightRecorder);
     }
     else {
         startButton->setVisible(false);
+        dumpButton->setVisible(false);
 
         // stop acquisition
         DataC->stopAcquisition();
 
         startButton->setText("Start");
         startButton->setVisible(true);
+        calibrateButton->setVisible(true);
+        stack->setCurrentIndex(0);
+    }
+}
+
+void Window::onCalibrate() {
+
+    // switch calibrate/back button
+    if (calibrateButton->text() == "Calibrate") {
+
+        // load and save config
+        settingsWgt->applySettings(CC, CH, DC);
+
+        // start calibration, results are shown in the log
+        boolret = DataC->startCalibration();
+        if (!boolret) return;
+
+        calibrateButton->setText("Back");
+        startButton->setVisible(false);
+        stack->setCurrentIndex(1);
+    }
+    else {
+        // wait for the calibration to finish
+        if (DataC->getCalibrating()) return;
+        DataC->joinCalibration();
+
+        calibrateButton->setText("Calibrate");
+        startButton->setVisible(true);
         stack->setCurrentIndex(0);
     }
 }
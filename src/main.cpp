@@ -1,10 +1,14 @@
 #include <iostream>
 
 #include <QApplication>
+#include <TROOT.h>
 #include <Window.h>
 
 int main(int argc, char *argv[]) {
 
+    // ROOT files are written from more than one thread
+    ROOT::EnableThreadSafety();
+
     QApplication app(argc, argv);
 
     Window w;
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include <NTupleOutput.h>
+
+namespace fs = std::filesystem;
+
+// converts data1, data2 and data3 of a TTree output file into RNTuples,
+// the other trees are copied unchanged (same layout as outputFormat "rntuple")
+// data1 of a split file is read from <input>_waveforms.root next to it
+//
+// usage: convert_to_rntuple <input.root> [output.root]
+
+// waveform sample from the old Double_t layout
+static UShort_t toSample(Double_t value) {
+    return static_cast<UShort_t>(std::clamp(std::lround(value), 0L, 65535L));
+}
+
+static void convertData1(TTree* tree, NTupleOutput& output) {
+
+    Long64_t ts_data1 = 0;
+    ULong64_t eventID = 0;
+    std::vector<UShort_t> ch[3];
+
+    // event IDs exist since the summary/waveform split
+    if (tree->GetBranch("eventID")) tree->SetBranchAddress("eventID", &eventID);
+
+    // UShort_t arrays with sample counters (current layout)
+    if (tree->GetBranch("ns0")) {
+        Int_t nSamples[3] = {0, 0, 0};
+        std::vector<UShort_t> buffer[3];
+
+        tree->SetBranchAddress("ts_data1", &ts_data1);
+        for (int channel = 0; channel <= 2; channel++) {
+            std::string n = "ns" + std::to_string(channel);
+            std::string c = "ch" + std::to_string(channel);
+
+            // buffers for the longest waveform of the file
+            buffer[channel].assign(std::max<size_t>(static_cast<size_t>(tree->GetMaximum(n.c_str())), 1), 0);
+            tree->SetBranchAddress(n.c_str(), &nSamples[channel]);
+            tree->SetBranchAddress(c.c_str(), buffer[channel].data());
+        }
+
+        Long64_t entries = tree->GetEntries();
+        for (Long64_t i = 0; i < entries; i++) {
+            tree->GetEntry(i);
+            for (int channel = 0; channel <= 2; channel++) {
+                ch[channel].assign(buffer[channel].begin(), buffer[channel].begin() + std::max(nSamples[channel], 0));
+            }
+            DigitizerData DData(eventID, 0, ch[0], ch[1], ch[2]);
+            DData.eventTime = ts_data1;
+            output.fillData1(DData);
+        }
+
+        tree->ResetBranchAddresses();
+        return;
+    }
+
+    // vector<Double_t> branches (files before the UShort_t layout)
+    std::vector<Double_t>* old[3] = {nullptr, nullptr, nullptr};
+    tree->SetBranchAddress("ts_data1", &ts_data1);
+    for (int channel = 0; channel <= 2; channel++) {
+        tree->SetBranchAddress(("ch" + std::to_string(channel)).c_str(), &old[channel]);
+    }
+
+    Long64_t entries = tree->GetEntries();
+    for (Long64_t i = 0; i < entries; i++) {
+        tree->GetEntry(i);
+        for (int channel = 0; channel <= 2; channel++) {
+            ch[channel].clear();
+            if (old[channel]) std::transform(old[channel]->begin(), old[channel]->end(), std::back_inserter(ch[channel]), toSample);
+        }
+        DigitizerData DData(eventID, 0, ch[0], ch[1], ch[2]);
+        DData.eventTime = ts_data1;
+        output.fillData1(DData);
+    }
+
+    tree->ResetBranchAddresses();
+}
+
+static void convertData2(TTree* tree, NTupleOutput& output) {
+
+    Long64_t ts_data2 = 0;
+    Double_t rate = 0;
+    Double_t pressure = 0;
+
+    tree->SetBranchAddress("ts_data2", &ts_data2);
+    tree->SetBranchAddress("rate", &rate);
+    tree->SetBranchAddress("pressure", &pressure);
+
+    Long64_t entries = tree->GetEntries();
+    for (Long64_t i = 0; i < entries; i++) {
+        tree->GetEntry(i);
+        output.fillData2(ts_data2, rate, pressure);
+    }
+
+    tree->ResetBranchAddresses();
+}
+
+static void convertData3(TTree* tree, NTupleOutput& output) {
+
+    static const char* tancaNames[8] = {
+        "tanca_h1", "tanca_t1", "tanca_h2", "tanca_t2",
+        "tanca_h3", "tanca_t3", "tanca_h4", "tanca_t4"
+    };
+
+    Long64_t ts_data3 = 0;
+    std::array<Double_t, 8> tanca{};
+
+    tree->SetBranchAddress("ts_data3", &ts_data3);
+    for (size_t i = 0; i < tanca.size(); i++) {
+        tree->SetBranchAddress(tancaNames[i], &tanca[i]);
+    }
+
+    Long64_t entries = tree->GetEntries();
+    for (Long64_t i = 0; i < entries; i++) {
+        tree->GetEntry(i);
+        output.fillData3(ts_data3, tanca);
+    }
+
+    tree->ResetBranchAddresses();
+}
+
+int main(int argc, char *argv[]) {
+
+    // check
+    if (argc < 2 || argc > 3) {
+        std::cerr << "usage: " << argv[0] << " <input.root> [output.root]" << std::endl;
+        return 1;
+    }
+
+    fs::path inputPath = argv[1];
+    fs::path outputPath = argc == 3
+        ? fs::path(argv[2])
+        : inputPath.parent_path() / (inputPath.stem().string() + "_rntuple.root");
+
+    // open files
+    TFile* input = TFile::Open(inputPath.c_str(), "READ");
+    if (!input || input->IsZombie()) {
+        std::cerr << "cannot open " << inputPath << std::endl;
+        return 1;
+    }
+
+    // keep the compression of the input file
+    TFile* output = TFile::Open(outputPath.c_str(), "RECREATE", "", input->GetCompressionSettings());
+    if (!output || output->IsZombie()) {
+        std::cerr << "cannot create " << outputPath << std::endl;
+        return 1;
+    }
+
+    // waveforms of a split file
+    TFile* waveforms = nullptr;
+    TTree* data1 = input->Get<TTree>("data1");
+    fs::path waveformPath = inputPath.parent_path() / (inputPath.stem().string() + "_waveforms.root");
+    if (!data1 && fs::exists(waveformPath)) {
+        waveforms = TFile::Open(waveformPath.c_str(), "READ");
+        if (!waveforms || waveforms->IsZombie()) {
+            std::cerr << "cannot open " << waveformPath << std::endl;
+            return 1;
+        }
+        data1 = waveforms->Get<TTree>("data1");
+    }
+    if (!data1) std::cerr << "warning: no data1 in " << inputPath << ", the output has no waveforms" << std::endl;
+
+    try {
+        NTupleOutput ntuples;
+        ntuples.open(output, input->GetCompressionSettings());
+
+        // convert
+        if (data1) convertData1(data1, ntuples);
+        if (TTree* tree = input->Get<TTree>("data2")) convertData2(tree, ntuples);
+        if (TTree* tree = input->Get<TTree>("data3")) convertData3(tree, ntuples);
+
+        ntuples.close();
+    } catch (const std::exception& e) {
+        std::cerr << "conversion failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    // copy the other trees
+    for (const char* name : {"features", "degradation", "alarms"}) {
+        TTree* tree = input->Get<TTree>(name);
+        if (!tree) continue;
+        output->cd();
+        TTree* copy = tree->CloneTree(-1, "fast");
+        if (copy) copy->Write();
+    }
+
+    output->Close();
+    input->Close();
+    if (waveforms) waveforms->Close();
+    delete output;
+    delete input;
+    delete waveforms;
+
+    std::cout << "converted " << inputPath << " to " << outputPath << std::endl;
+
+    return 0;
+}
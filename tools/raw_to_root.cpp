@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Compression.h>
+#include <TFile.h>
+#include <TTree.h>
+
+#include <RawLogReader.h>
+#include <WaveformCodec.h>
+
+// converts raw event log segments into the data1, data2 and data3 trees
+// of the ROOT output files (same branches as the RootTreeWriter)
+//
+// usage: raw_to_root <output.root> <segment.raw> [segment.raw ...]
+//        raw_to_root --selftest (round trips of the waveform codec)
+
+static bool selfTest() {
+
+    std::mt19937 random(1);
+    std::normal_distribution<double> noise(0, 2);
+    std::uniform_int_distribution<int> anyValue(0, 65535);
+
+    // channels: name and samples
+    std::vector<std::pair<std::string, std::vector<uint16_t>>> channels;
+    channels.push_back({"empty", {}});
+    channels.push_back({"1 sample", {2048}});
+    channels.push_back({"flat", std::vector<uint16_t>(500, 2048)});
+
+    // 12-bit noise on a baseline with a pulse, lengths around the block size
+    for (size_t n : {2, 31, 32, 33, 64, 65, 1030}) {
+        std::vector<uint16_t> samples(n);
+        for (size_t i = 0; i < n; i++) {
+            double pulse = (i >= n / 2 && i < n / 2 + 20) ? 1500.0 * (1 - (i - n / 2) / 20.0) : 0;
+            samples[i] = static_cast<uint16_t>(std::clamp(2048 + noise(random) - pulse, 0.0, 4095.0));
+        }
+        channels.push_back({"12-bit noise " + std::to_string(n), samples});
+    }
+
+    // full 16-bit range, largest deltas
+    std::vector<uint16_t> full(1000);
+    for (auto& sample : full) sample = static_cast<uint16_t>(anyValue(random));
+    channels.push_back({"full range", full});
+    std::vector<uint16_t> alternating(100);
+    for (size_t i = 0; i < alternating.size(); i++) alternating[i] = i % 2 ? 65535 : 0;
+    channels.push_back({"alternating 0/65535", alternating});
+
+    // all channels in one buffer, as in a record
+    std::vector<uint8_t> encoded;
+    std::vector<size_t> ends;
+    for (const auto& [name, samples] : channels) {
+        WaveformCodec::encode(samples.data(), samples.size(), encoded);
+        ends.push_back(encoded.size());
+    }
+
+    bool ok = true;
+    const uint8_t* data = encoded.data();
+    const uint8_t* end = encoded.data() + encoded.size();
+    std::vector<uint16_t> decoded;
+    for (size_t i = 0; i < channels.size(); i++) {
+        const auto& [name, samples] = channels[i];
+        bool decodedOk = WaveformCodec::decode(data, end, decoded);
+        bool same = decodedOk && decoded == samples && data == encoded.data() + ends[i];
+        std::cout << (same ? "ok     " : "FAILED ") << name << ": " << samples.size() << " samples, "
+                  << ends[i] - (i ? ends[i - 1] : 0) << " bytes" << std::endl;
+        ok = ok && same;
+        if (!decodedOk) break;
+    }
+
+    // truncated channels are rejected
+    for (size_t i = 0; i < channels.size(); i++) {
+        size_t start = i ? ends[i - 1] : 0;
+        for (size_t length = 0; length < ends[i] - start; length++) {
+            const uint8_t* cut = encoded.data() + start;
+            if (WaveformCodec::decode(cut, cut + length, decoded)) {
+                std::cout << "FAILED " << channels[i].first << ": truncated to " << length << " bytes not detected" << std::endl;
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    std::cout << (ok ? "selftest passed" : "selftest FAILED") << std::endl;
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+
+    // round trips of the codec
+    if (argc == 2 && std::string(argv[1]) == "--selftest") return selfTest() ? 0 : 1;
+
+    // check
+    if (argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <output.root> <segment.raw> [segment.raw ...]" << std::endl;
+        std::cerr << "       " << argv[0] << " --selftest" << std::endl;
+        return 1;
+    }
+
+    TFile* file = TFile::Open(argv[1], "RECREATE", "", ROOT::CompressionSettings(ROOT::RCompressionSetting::EAlgorithm::kZSTD, 5));
+    if (!file || file->IsZombie()) {
+        std::cerr << "cannot create " << argv[1] << std::endl;
+        return 1;
+    }
+
+    // trees
+    TTree* data1 = new TTree("data1", "Digitizer Data");
+    TTree* data2 = new TTree("data2", "Arduino Data 1");
+    TTree* data3 = new TTree("data3", "Arduino Data 2");
+
+    // branch placeholder variables
+    Long64_t ts_data1 = 0;
+    ULong64_t eventID = 0;
+    Int_t nSamples[3] = {0, 0, 0};
+    std::vector<UShort_t> waveform[3];
+
+    Long64_t ts_data2 = 0;
+    Double_t rate = 0;
+    Double_t pressure = 0;
+
+    static const char* tancaNames[8] = {
+        "tanca_h1", "tanca_t1", "tanca_h2", "tanca_t2",
+        "tanca_h3", "tanca_t3", "tanca_h4", "tanca_t4"
+    };
+    Long64_t ts_data3 = 0;
+    std::array<Double_t, 8> tanca{};
+
+    // define Branches
+    data1->Branch("ts_data1",   &ts_data1,   "ts_data1/L");
+    data1->Branch("eventID",    &eventID,    "eventID/l");
+    for (int channel = 0; channel <= 2; channel++) {
+        std::string n = "ns" + std::to_string(channel);
+        std::string ch = "ch" + std::to_string(channel);
+        waveform[channel].assign(1, 0);
+        data1->Branch(n.c_str(),  &nSamples[channel],         (n + "/I").c_str());
+        data1->Branch(ch.c_str(), waveform[channel].data(),   (ch + "[" + n + "]/s").c_str());
+    }
+
+    data2->Branch("ts_data2",   &ts_data2,   "ts_data2/L");
+    data2->Branch("rate",       &rate,       "rate/D");
+    data2->Branch("pressure",   &pressure,   "pressure/D");
+
+    data3->Branch("ts_data3",   &ts_data3,   "ts_data3/L");
+    for (size_t i = 0; i < tanca.size(); i++) {
+        data3->Branch(tancaNames[i], &tanca[i], (std::string(tancaNames[i]) + "/D").c_str());
+    }
+
+    // segments in the given order
+    Long64_t records = 0;
+    std::vector<uint16_t> samples[3];
+    for (int i = 2; i < argc; i++) {
+        RawLogReader reader;
+        if (!reader.open(argv[i])) {
+            std::cerr << "cannot read segment " << argv[i] << std::endl;
+            return 1;
+        }
+
+        while (const RawRecordHeader* record = reader.next()) {
+            switch (record->type) {
+
+                case RawDigitizer: {
+                    if (!RawLogReader::waveforms(record, samples)) {
+                        std::cerr << "damaged digitizer record in " << argv[i] << std::endl;
+                        continue;
+                    }
+                    ts_data1 = record->time;
+                    eventID = RawLogReader::payload<RawDigitizerRecord>(record)->eventID;
+                    for (int channel = 0; channel <= 2; channel++) {
+                        size_t n = samples[channel].size();
+
+                        // longer than the buffer
+                        if (n > waveform[channel].size()) {
+                            waveform[channel].resize(n);
+                            data1->SetBranchAddress(("ch" + std::to_string(channel)).c_str(), waveform[channel].data());
+                        }
+
+                        nSamples[channel] = static_cast<Int_t>(n);
+                        std::copy(samples[channel].begin(), samples[channel].end(), waveform[channel].begin());
+                    }
+                    data1->Fill();
+                    break;
+                }
+
+                case RawArduino: {
+                    const RawArduinoRecord* arduino = RawLogReader::payload<RawArduinoRecord>(record);
+                    ts_data2 = record->time;
+                    rate = arduino->rate;
+                    pressure = arduino->pressure;
+                    data2->Fill();
+                    break;
+                }
+
+                case RawTanca: {
+                    const RawTancaRecord* values = RawLogReader::payload<RawTancaRecord>(record);
+                    ts_data3 = record->time;
+                    std::copy(values->tanca, values->tanca + 8, tanca.begin());
+                    data3->Fill();
+                    break;
+                }
+
+                // unknown records of newer versions
+                default:
+                    continue;
+            }
+            records++;
+        }
+
+        // segment of a crashed run
+        if (reader.getTruncated()) {
+            std::cerr << "segment " << argv[i] << " ends with an incomplete record" << std::endl;
+        }
+    }
+
+    // write TTrees in file
+    file->cd();
+    data1->Write();
+    data2->Write();
+    data3->Write();
+    file->Close();
+    delete file;
+
+    std::cout << "converted " << records << " records to " << argv[1] << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <FileRecovery.h>
+
+// salvages output files of a crashed run: ROOT rebuilds the key list and
+// the trees keep the entries of their last checkpoint (AutoSave)
+//
+// usage: recover_file <file.root | directory> [...]
+// (a directory is searched for the .open markers the collector leaves while writing)
+
+int main(int argc, char *argv[]) {
+
+    // check
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file.root | directory> [...]" << std::endl;
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = 1; i < argc; i++) {
+        fs::path arg = argv[i];
+
+        // single file
+        if (!fs::is_directory(arg)) {
+            std::string report;
+            if (!FileRecovery::recover(arg, report)) failed++;
+            std::cout << report << std::endl;
+            continue;
+        }
+
+        // files with marker
+        for (const fs::path& marker : FileRecovery::findMarkers(arg)) {
+            bool recovered = true;
+            for (const fs::path& path : FileRecovery::readMarker(marker)) {
+                std::string report;
+                recovered = FileRecovery::recover(path, report) && recovered;
+                std::cout << report << std::endl;
+            }
+
+            // keep the marker of files that could not be recovered as .failed
+            if (recovered) {
+                fs::remove(marker);
+            } else {
+                std::cout << "not recovered, marker kept as " << FileRecovery::markFailed(marker).string() << std::endl;
+                failed++;
+            }
+        }
+    }
+
+    return failed > 0 ? 1 : 0;
+}